@@ -1,9 +1,24 @@
 #include <iostream>
 #include <vector>
 #include <string>
+#include <string_view>
 #include <cstdlib>
+#include <climits>
 #include <windows.h>
 #include <fstream>
+#include <cctype>
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <sys/stat.h>
+#include <thread>
+#include <mutex>
+#include <atomic>
+#include <condition_variable>
+#include <iterator>
+#include <memory>
+#include <deque>
+#include <cstdint>
 
 using namespace std;
 #ifdef _WIN32
@@ -11,15 +26,245 @@ using namespace std;
 #elif defined(__linux__) || defined(__APPLE__)
 #include <termios.h>
 #include <unistd.h>
+#include <sys/ioctl.h>
+#include <poll.h>
+#include <fcntl.h>
 #endif
+#ifdef __linux__
+#include <sys/inotify.h>
+#endif
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define TEXTEDITOR_SSE2
+#endif
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+// compressed files are opt-in: define TEXTEDITOR_ZLIB and link -lz for .gz, define
+// TEXTEDITOR_ZSTD and link -lzstd for .zst; MSVC picks the libraries up by name
+#ifdef TEXTEDITOR_ZLIB
+#include <zlib.h>
+#ifdef _MSC_VER
+#pragma comment(lib, "zlib")
+#endif
+#endif
+#ifdef TEXTEDITOR_ZSTD
+#include <zstd.h>
+#ifdef _MSC_VER
+#pragma comment(lib, "zstd")
+#endif
+#endif
+
+// character classes
+enum CharClass : unsigned char { CC_OTHER, CC_WORD, CC_PUNCT, CC_SPACE };
+
+struct CharClassTable {
+    unsigned char cls[256];
+};
+
+constexpr CharClassTable makeCharClassTable() {
+    CharClassTable table{};
+    for (int c = 0; c < 256; ++c) {
+        if ((c >= 'A' && c <= 'Z') || (c >= 'a' && c <= 'z') || (c >= '0' && c <= '9'))
+            table.cls[c] = CC_WORD;
+        else if (c == '.' || c == ',' || c == ';' || c == ':' || c == '!' || c == '?' ||
+            c == '"' || c == '\'' || c == '(' || c == ')' || c == '-' || c == '_')
+            table.cls[c] = CC_PUNCT;
+        else if (c == ' ' || c == '\t' || c == '\r' || c == '\n' || c == '\v' || c == '\f')
+            table.cls[c] = CC_SPACE;
+        else
+            table.cls[c] = CC_OTHER;
+    }
+    return table;
+}
+
+constexpr CharClassTable charClasses = makeCharClassTable();
+
+inline CharClass charClassOf(char c) {
+    return static_cast<CharClass>(charClasses.cls[static_cast<unsigned char>(c)]);
+}
+
+inline bool isWordByte(char c) {
+    return charClassOf(c) == CC_WORD;
+}
+
+inline int lowestSetBit(unsigned mask) {
+#ifdef _MSC_VER
+    unsigned long index;
+    _BitScanForward(&index, mask);
+    return static_cast<int>(index);
+#else
+    return __builtin_ctz(mask);
+#endif
+}
+
+inline int highestSetBit(unsigned mask) {
+#ifdef _MSC_VER
+    unsigned long index;
+    _BitScanReverse(&index, mask);
+    return static_cast<int>(index);
+#else
+    return 31 - __builtin_clz(mask);
+#endif
+}
+
+inline int countSetBits(unsigned mask) {
+    mask = mask - ((mask >> 1) & 0x55555555u);
+    mask = (mask & 0x33333333u) + ((mask >> 2) & 0x33333333u);
+    return static_cast<int>((((mask + (mask >> 4)) & 0x0F0F0F0Fu) * 0x01010101u) >> 24);
+}
+
+// Bit i is set when p[i] is CC_WORD. The SSE2 path tests the same ranges as the table.
+inline unsigned wordMask16(const char* p) {
+#ifdef TEXTEDITOR_SSE2
+    __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p));
+    __m128i letter = _mm_sub_epi8(_mm_or_si128(v, _mm_set1_epi8(0x20)), _mm_set1_epi8('a'));
+    __m128i isLetter = _mm_cmpeq_epi8(_mm_min_epu8(letter, _mm_set1_epi8(25)), letter);
+    __m128i digit = _mm_sub_epi8(v, _mm_set1_epi8('0'));
+    __m128i isDigit = _mm_cmpeq_epi8(_mm_min_epu8(digit, _mm_set1_epi8(9)), digit);
+    return static_cast<unsigned>(_mm_movemask_epi8(_mm_or_si128(isLetter, isDigit)));
+#else
+    unsigned mask = 0;
+    for (int i = 0; i < 16; ++i) {
+        if (isWordByte(p[i])) mask |= 1u << i;
+    }
+    return mask;
+#endif
+}
+
+// first index >= pos whose word-ness differs from inWord, or len
+inline size_t scanWordRun(const char* text, size_t pos, size_t len, bool inWord) {
+    while (pos + 16 <= len) {
+        unsigned mask = wordMask16(text + pos);
+        if (inWord) mask = ~mask & 0xFFFFu;
+        if (mask) return pos + lowestSetBit(mask);
+        pos += 16;
+    }
+    while (pos < len && isWordByte(text[pos]) == inWord) {
+        ++pos;
+    }
+    return pos;
+}
+
+// smallest index <= pos such that text[index..pos) all have word-ness inWord
+inline size_t scanWordRunBack(const char* text, size_t pos, bool inWord) {
+    while (pos >= 16) {
+        unsigned mask = wordMask16(text + pos - 16);
+        if (inWord) mask = ~mask & 0xFFFFu;
+        if (mask) return pos - 16 + highestSetBit(mask) + 1;
+        pos -= 16;
+    }
+    while (pos > 0 && isWordByte(text[pos - 1]) == inWord) {
+        --pos;
+    }
+    return pos;
+}
+
+inline size_t countWords(const char* text, size_t len) {
+    size_t words = 0;
+    unsigned carry = 0;
+    size_t i = 0;
+    for (; i + 16 <= len; i += 16) {
+        unsigned mask = wordMask16(text + i);
+        words += countSetBits(mask & ~((mask << 1) | carry) & 0xFFFFu);
+        carry = (mask >> 15) & 1u;
+    }
+    for (; i < len; ++i) {
+        unsigned inWord = isWordByte(text[i]) ? 1u : 0u;
+        if (inWord && !carry) words++;
+        carry = inWord;
+    }
+    return words;
+}
+
+struct LineStats {
+    size_t bytes;
+    size_t words;
+    size_t codePoints;
+
+    LineStats() : bytes(0), words(0), codePoints(0) {}
+
+    LineStats& operator+=(const LineStats& other) {
+        bytes += other.bytes;
+        words += other.words;
+        codePoints += other.codePoints;
+        return *this;
+    }
+    LineStats& operator-=(const LineStats& other) {
+        bytes -= other.bytes;
+        words -= other.words;
+        codePoints -= other.codePoints;
+        return *this;
+    }
+};
+
+inline bool isUtf8Continuation(char c) {
+    return (static_cast<unsigned char>(c) & 0xC0) == 0x80;
+}
+
+// length of the well-formed UTF-8 sequence starting at text[pos], or 1 for an invalid byte
+inline size_t utf8SequenceLength(const char* text, size_t pos, size_t len) {
+    unsigned char lead = static_cast<unsigned char>(text[pos]);
+    if (lead < 0x80) return 1;
+    size_t need;
+    unsigned char low = 0x80, high = 0xBF;
+    if (lead >= 0xC2 && lead <= 0xDF) need = 2;
+    else if (lead >= 0xE0 && lead <= 0xEF) {
+        need = 3;
+        if (lead == 0xE0) low = 0xA0;
+        if (lead == 0xED) high = 0x9F;
+    }
+    else if (lead >= 0xF0 && lead <= 0xF4) {
+        need = 4;
+        if (lead == 0xF0) low = 0x90;
+        if (lead == 0xF4) high = 0x8F;
+    }
+    else return 1;
+    if (pos + need > len) return 1;
+    unsigned char second = static_cast<unsigned char>(text[pos + 1]);
+    if (second < low || second > high) return 1;
+    for (size_t i = 2; i < need; ++i) {
+        if (!isUtf8Continuation(text[pos + i])) return 1;
+    }
+    return need;
+}
+
+// bit i is set when p[i] is outside ASCII
+inline unsigned nonAsciiMask16(const char* p) {
+#ifdef TEXTEDITOR_SSE2
+    return static_cast<unsigned>(_mm_movemask_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i*>(p))));
+#else
+    unsigned mask = 0;
+    for (int i = 0; i < 16; ++i) {
+        if (static_cast<unsigned char>(p[i]) >= 0x80) mask |= 1u << i;
+    }
+    return mask;
+#endif
+}
+
+enum TokenColor : unsigned char { TC_DEFAULT, TC_KEYWORD, TC_STRING, TC_COMMENT, TC_NUMBER, TC_SECTION, TC_SELECTED };
+
+// every code resets first so switching straight from one color to another is safe
+inline const char* tokenColorCode(unsigned char color) {
+    switch (color) {
+    case TC_KEYWORD: return "\x1b[0;1;34m";
+    case TC_STRING: return "\x1b[0;32m";
+    case TC_COMMENT: return "\x1b[0;90m";
+    case TC_NUMBER: return "\x1b[0;35m";
+    case TC_SECTION: return "\x1b[0;1;36m";
+    case TC_SELECTED: return "\x1b[0;7m";
+    default: return "\x1b[0m";
+    }
+}
 
 class Node {
 public:
     char data;
+    unsigned int index; // position in the line, valid while the line's node cache is
     Node* next;
     Node* prev;
 
-    Node(char ch) : data(ch), next(nullptr), prev(nullptr) {}
+    Node(char ch) : data(ch), index(0), next(nullptr), prev(nullptr) {}
 };
 
 class LinkedList {
@@ -27,6 +272,79 @@ private:
     Node* head;
     Node* tail;
 
+    // contiguous copy of the line and a node-by-position table, rebuilt on demand after edits
+    mutable string textCache;
+    mutable vector<Node*> nodeCache;
+    mutable bool textCacheValid;
+    mutable bool nodeCacheValid;
+    // byte offset of every column (code point) start; empty while the line is pure ASCII
+    mutable vector<unsigned int> columnStarts;
+    mutable bool columnIndexValid;
+    LineStats stats;
+
+    // words starting in the run prev, ch, next that are attributed to ch being present
+    static int wordStartsAround(const Node* prev, char ch, const Node* next) {
+        bool prevWord = prev && isWordByte(prev->data);
+        bool chWord = isWordByte(ch);
+        bool nextWord = next && isWordByte(next->data);
+        return (chWord && !prevWord) + (nextWord && !chWord) - (nextWord && !prevWord);
+    }
+
+    void countInserted(const Node* node) {
+        stats.bytes++;
+        if (!isUtf8Continuation(node->data)) stats.codePoints++;
+        stats.words += wordStartsAround(node->prev, node->data, node->next);
+    }
+
+    void countDeleted(const Node* node) {
+        stats.bytes--;
+        if (!isUtf8Continuation(node->data)) stats.codePoints--;
+        stats.words -= wordStartsAround(node->prev, node->data, node->next);
+    }
+
+    void invalidateCache() {
+        textCacheValid = false;
+        nodeCacheValid = false;
+        columnIndexValid = false;
+    }
+
+    void buildColumnIndex() const {
+        columnStarts.clear();
+        columnIndexValid = true;
+        if (stats.codePoints == stats.bytes) {
+            // no continuation bytes: only multi-byte sequences could shift columns
+            const string& text = content();
+            size_t i = 0;
+            while (i + 16 <= text.size() && nonAsciiMask16(text.data() + i) == 0) i += 16;
+            while (i < text.size() && static_cast<unsigned char>(text[i]) < 0x80) ++i;
+            if (i == text.size()) return;
+        }
+        const string& text = content();
+        columnStarts.reserve(stats.codePoints);
+        size_t i = 0;
+        while (i < text.size()) {
+            if (i + 16 <= text.size() && nonAsciiMask16(text.data() + i) == 0) {
+                for (size_t j = 0; j < 16; ++j) columnStarts.push_back(static_cast<unsigned int>(i + j));
+                i += 16;
+                continue;
+            }
+            columnStarts.push_back(static_cast<unsigned int>(i));
+            i += utf8SequenceLength(text.data(), i, text.size());
+        }
+    }
+
+    void buildNodeCache() const {
+        nodeCache.clear();
+        textCache.clear();
+        for (Node* temp = head; temp; temp = temp->next) {
+            temp->index = static_cast<unsigned int>(nodeCache.size());
+            nodeCache.push_back(temp);
+            textCache += temp->data;
+        }
+        textCacheValid = true;
+        nodeCacheValid = true;
+    }
+
 public:
     class Iterator {
     private:
@@ -59,9 +377,13 @@ public:
             return current;
         }
     };
-    LinkedList() : head(nullptr), tail(nullptr) {}
+    LinkedList() : head(nullptr), tail(nullptr), textCacheValid(false), nodeCacheValid(false), columnIndexValid(false) {}
 
+    // edits of a paged-out line are refused: its text is not here to edit, and linking
+    // nodes in would leave the statistics describing text that no longer exists
     void insertChar(Iterator& iter, char ch) {
+        if (isPagedOut()) return;
+        invalidateCache();
         Node* newNode = new Node(ch);
         Node* current = iter.getNode();
 
@@ -80,16 +402,20 @@ public:
             current->next = newNode;
             if (!newNode->next) tail = newNode;
         }
+        countInserted(newNode);
         iter = Iterator(newNode);
     }
     void deleteChar(Iterator& iter) {
         Node* current = iter.getNode();
 
         if (!current) return;
+        invalidateCache();
+        countDeleted(current);
 
         if (current == head) {
             head = head->next;
             if (head) head->prev = nullptr;
+            else tail = nullptr;
             delete current;
             iter = Iterator(head);
         }
@@ -128,10 +454,17 @@ public:
     Iterator last() {
         return Iterator(tail);
     }
-    bool printLine(const Iterator& cursor, bool cursorPrinted) const {
+    bool printLine(const Iterator& cursor, bool cursorPrinted, const vector<unsigned char>* colors = nullptr) const {
         Node* temp = head;
+        size_t index = 0;
+        unsigned char activeColor = 0;
 
         while (temp) {
+            if (colors && index < colors->size() && (*colors)[index] != activeColor) {
+                activeColor = (*colors)[index];
+                cout << tokenColorCode(activeColor);
+            }
+            index++;
             cout << temp->data;
             if (cursor.getNode() == temp && !cursorPrinted) {
                 cout << "|";
@@ -139,9 +472,11 @@ public:
             }
             temp = temp->next;
         }
+        if (activeColor) cout << tokenColorCode(0);
         return cursorPrinted;
     }
     void deleteLine() {
+        invalidateCache();
         Node* temp = head;
         while (temp) {
             Node* next = temp->next;
@@ -149,334 +484,4008 @@ public:
             temp = next;
         }
         head = tail = nullptr;
+        stats = LineStats();
     }
     bool isEmpty() const {
         return head == nullptr;
     }
 
-    string getLineContent() const {
-        string content;
-        Node* temp = head;
-        while (temp) {
-            content += temp->data;
-            temp = temp->next;
-        }
-        return content;
+    // frees the nodes but keeps the statistics, for a line whose text is stored elsewhere
+    void pageOut() {
+        LineStats kept = stats;
+        deleteLine();
+        stats = kept;
     }
-};
 
+    bool isPagedOut() const {
+        return head == nullptr && stats.bytes > 0;
+    }
 
-class FileManager {
-private:
-    string currentFileName;
-    bool modified;
+    // moves all of other's nodes onto the end of this line without copying them
+    void splice(LinkedList& other) {
+        if (other.isEmpty() || isPagedOut()) return;
+        bool joinsWord = tail && isWordByte(tail->data) && isWordByte(other.head->data);
+        if (tail) {
+            tail->next = other.head;
+            other.head->prev = tail;
+        }
+        else {
+            head = other.head;
+        }
+        tail = other.tail;
+        stats += other.stats;
+        if (joinsWord) stats.words--;
+        invalidateCache();
+        other.head = other.tail = nullptr;
+        other.stats = LineStats();
+        other.invalidateCache();
+    }
 
-public:
-    FileManager() : modified(false) {}
+    // removes bytes [from, to) in one pass over the affected nodes
+    void eraseRange(size_t from, size_t to) {
+        if (to > stats.bytes) to = stats.bytes;
+        if (from >= to) return;
+        Node* node = at(from).getNode();
+        invalidateCache();
+        for (size_t i = from; i < to && node; ++i) {
+            Node* next = node->next;
+            countDeleted(node);
+            if (node->prev) node->prev->next = next;
+            else head = next;
+            if (next) next->prev = node->prev;
+            else tail = node->prev;
+            delete node;
+            node = next;
+        }
+    }
 
-    bool loadFile(const std::string& filename) {
-        ifstream file(filename);
-        if (!file.is_open()) {
-            return false;
+    // builds the text as one chain the way fromText does, links it in once and updates the
+    // statistics once: only the words at the two seams can merge or split
+    void insertText(size_t offset, const char* text, size_t len) {
+        if (len == 0 || isPagedOut()) return;
+        LinkedList piece = fromText(text, len);
+        Node* prev = offset == 0 || !head ? nullptr : at(min(offset, stats.bytes) - 1).getNode();
+        Node* next = prev ? prev->next : head;
+        bool prevWord = prev && isWordByte(prev->data);
+        bool nextWord = next && isWordByte(next->data);
+        // unsigned wrap-around makes the seam corrections subtract correctly
+        stats.words += piece.stats.words + (prevWord && nextWord) - (prevWord && isWordByte(piece.head->data)) -
+            (nextWord && isWordByte(piece.tail->data));
+        stats.bytes += piece.stats.bytes;
+        stats.codePoints += piece.stats.codePoints;
+        piece.head->prev = prev;
+        if (prev) prev->next = piece.head;
+        else head = piece.head;
+        piece.tail->next = next;
+        if (next) next->prev = piece.tail;
+        else tail = piece.tail;
+        piece.head = piece.tail = nullptr;
+        invalidateCache();
+    }
+
+    // links the nodes directly and counts the whole line at once instead of per insert
+    static LinkedList fromText(const char* text, size_t len) {
+        LinkedList line;
+        Node* prev = nullptr;
+        size_t continuationBytes = 0;
+        for (size_t i = 0; i < len; ++i) {
+            Node* node = new Node(text[i]);
+            node->prev = prev;
+            if (prev) prev->next = node;
+            else line.head = node;
+            prev = node;
+            if (isUtf8Continuation(text[i])) continuationBytes++;
         }
-        currentFileName = filename;
-        modified = false;
-        return true;
+        line.tail = prev;
+        line.stats.bytes = len;
+        line.stats.words = countWords(text, len);
+        line.stats.codePoints = len - continuationBytes;
+        return line;
     }
 
-    bool saveFile(const std::string& filename, const std::vector<LinkedList>& lines) {
-        ofstream file(filename);
-        if (!file.is_open()) {
-            return false;
+    // a paged-out line: only the statistics fromText would compute, no nodes
+    static LinkedList pagedOut(const char* text, size_t len) {
+        LinkedList line;
+        size_t continuationBytes = 0;
+        for (size_t i = 0; i < len; ++i) {
+            if (isUtf8Continuation(text[i])) continuationBytes++;
         }
-        for (const auto& line : lines) {
-            file << line.getLineContent() << '\n';
+        line.stats.bytes = len;
+        line.stats.words = countWords(text, len);
+        line.stats.codePoints = len - continuationBytes;
+        return line;
+    }
+
+    string getLineContent() const {
+        return content();
+    }
+
+    const string& content() const {
+        if (!textCacheValid) {
+            textCache.clear();
+            for (Node* temp = head; temp; temp = temp->next) {
+                textCache += temp->data;
+            }
+            textCacheValid = true;
         }
-        currentFileName = filename;
-        modified = false;
-        return true;
+        return textCache;
     }
 
-    bool hasUnsavedChanges() const {
-        return modified;
+    size_t size() const {
+        return stats.bytes;
     }
 
-    void markAsModified() {
-        modified = true;
+    const LineStats& getStats() const {
+        return stats;
     }
 
-    string getCurrentFileName() const {
-        return currentFileName.empty() ? "[No File]" : currentFileName;
+    // node at byte position index, or end() past the last character
+    Iterator at(size_t index) const {
+        if (!nodeCacheValid) buildNodeCache();
+        return Iterator(index < nodeCache.size() ? nodeCache[index] : nullptr);
+    }
+
+    size_t indexOf(const Iterator& iter) const {
+        if (!iter.getNode()) return 0;
+        if (!nodeCacheValid) buildNodeCache();
+        return iter.getNode()->index;
+    }
+
+    // number of columns before the given byte offset
+    size_t columnOfOffset(size_t offset) const {
+        if (!columnIndexValid) buildColumnIndex();
+        if (columnStarts.empty()) return offset;
+        return lower_bound(columnStarts.begin(), columnStarts.end(), offset) - columnStarts.begin();
+    }
+
+    // byte offset where the given column starts, or the line length past the end
+    size_t offsetOfColumn(size_t column) const {
+        if (!columnIndexValid) buildColumnIndex();
+        if (columnStarts.empty()) return min(column, stats.bytes);
+        return column < columnStarts.size() ? columnStarts[column] : stats.bytes;
     }
 };
 
-class SearchEngine {
-private:
-    string lastPattern;
-    size_t lastMatchLine;
-    size_t lastMatchColumn;
 
+enum Compression { COMPRESSION_NONE, COMPRESSION_GZIP, COMPRESSION_ZSTD };
+
+// Streaming readers/writers so compressed files never exist decompressed on disk.
+class ByteSource {
 public:
-    SearchEngine() : lastPattern(""), lastMatchLine(0), lastMatchColumn(0) {}
+    virtual ~ByteSource() {}
+    // fills up to capacity bytes; 0 means end of data or failed()
+    virtual size_t read(char* out, size_t capacity) = 0;
+    // bytes of the underlying file consumed so far, for progress
+    virtual long long consumed() const = 0;
+    virtual bool failed() const = 0;
+};
 
-    bool search(const string& pattern, vector<LinkedList>& lines, int& currentLine, LinkedList::Iterator& charCursor,int cursorPos) 
-    {
-        lastPattern = pattern;
-        string content = lines[currentLine].getLineContent();
+class PlainSource : public ByteSource {
+private:
+    ifstream file;
+    long long position;
 
-        size_t pos = content.find(pattern, cursorPos);
-        if (pos != string::npos) {
-            charCursor = lines[currentLine].begin();
-            for (size_t j = 0; j < pos; ++j) {
-                ++charCursor;
-            }
-            lastMatchLine = currentLine;
-            lastMatchColumn = pos;
-            return true;
-        }
+public:
+    PlainSource(const string& filename) : file(filename, ios::binary), position(0) {}
 
-        for (int i = currentLine + 1; i < lines.size(); ++i) {
-            content = lines[i].getLineContent();
-            pos = content.find(pattern);
-            if (pos != string::npos) {
-                currentLine = i;
-                charCursor = lines[i].begin();
-                for (size_t j = 0; j < pos; ++j) {
-                    ++charCursor;
-                }
-                lastMatchLine = i;
-                lastMatchColumn = pos;
-                return true;
-            }
-        }
-        return false;
+    bool isOpen() const {
+        return file.is_open();
     }
 
+    size_t read(char* out, size_t capacity) override {
+        file.read(out, capacity);
+        size_t got = static_cast<size_t>(file.gcount());
+        position += got;
+        return got;
+    }
 
-    bool findNext(vector<LinkedList>& lines, int& currentLine, LinkedList::Iterator& charCursor,int cursorPos) 
-    {
-        if (lastPattern.empty()) return false;
-        return search(lastPattern, lines, currentLine, charCursor, cursorPos);
+    long long consumed() const override {
+        return position;
     }
 
-    bool findPrevious(vector<LinkedList>& lines, int& currentLine, LinkedList::Iterator& charCursor,int cursorPos) 
-    {
-        if (lastPattern.empty()) return false;
+    bool failed() const override {
+        return false;
+    }
+};
 
-        string content = lines[currentLine].getLineContent();
+#ifdef TEXTEDITOR_ZLIB
+class GzipSource : public ByteSource {
+private:
+    PlainSource raw;
+    z_stream stream;
+    vector<char> input;
+    bool memberEnded;
+    bool done;
+    bool error;
 
-        size_t pos = content.rfind(lastPattern, cursorPos - 2);
-        if (pos != string::npos) {
-            charCursor = lines[currentLine].begin();
-            for (size_t j = 0; j < pos; ++j) {
-                ++charCursor;
-            }
-            lastMatchLine = currentLine;
-            lastMatchColumn = pos;
-            return true;
-        }
-        return false;
+public:
+    GzipSource(const string& filename) : raw(filename), input(1 << 16), memberEnded(false), done(false), error(false) {
+        memset(&stream, 0, sizeof(stream));
+        // 15 + 32: accept gzip or zlib headers
+        if (inflateInit2(&stream, 15 + 32) != Z_OK) error = done = true;
     }
 
-    bool replace(const string& old, const string& newStr, LinkedList& line, bool global = false) 
-    {
-        string content = line.getLineContent();
-        size_t pos = content.find(old);
-        if (pos == string::npos) return false;
+    ~GzipSource() {
+        inflateEnd(&stream);
+    }
 
-        while (pos != string::npos) {
-            line.deleteLine();
-            LinkedList::Iterator iter = line.end();
-            for (size_t i = 0; i < pos; ++i) {
-                line.insertChar(iter, content[i]);
+    size_t read(char* out, size_t capacity) override {
+        stream.next_out = reinterpret_cast<Bytef*>(out);
+        stream.avail_out = static_cast<uInt>(capacity);
+        while (stream.avail_out > 0 && !done) {
+            if (stream.avail_in == 0) {
+                size_t got = raw.read(input.data(), input.size());
+                if (got == 0) {
+                    done = true;
+                    error = !memberEnded;
+                    break;
+                }
+                stream.next_in = reinterpret_cast<Bytef*>(input.data());
+                stream.avail_in = static_cast<uInt>(got);
             }
-            for (char ch : newStr) {
-                line.insertChar(iter, ch);
+            int result = inflate(&stream, Z_NO_FLUSH);
+            if (result == Z_STREAM_END) {
+                // concatenated members decode as one stream
+                memberEnded = true;
+                inflateReset(&stream);
             }
-            for (size_t i = pos + old.size(); i < content.size(); ++i) {
-                line.insertChar(iter, content[i]);
+            else if (result == Z_OK) {
+                memberEnded = false;
+            }
+            else if (result != Z_BUF_ERROR) {
+                done = error = true;
             }
-
-            if (!global) break;
-            content = line.getLineContent();
-            pos = content.find(old, pos + newStr.size());
         }
-        return true;
+        return capacity - stream.avail_out;
     }
-};
 
-struct EditorStatus {
-    enum Mode { INSERT, NORMAL };
-    Mode currentMode;
-    size_t cursorLine;
-    size_t cursorColumn;
-    size_t totalLines;
-    string lastCommand;
-};
+    long long consumed() const override {
+        return raw.consumed() - stream.avail_in;
+    }
 
+    bool failed() const override {
+        return error;
+    }
+};
+#endif
 
-class TextEditor {
+#ifdef TEXTEDITOR_ZSTD
+class ZstdSource : public ByteSource {
 private:
-    vector<LinkedList> lines;
-    int currentLine;
-    LinkedList::Iterator charCursor;
-    bool insertMode;
-    string copyBuffer;
-    EditorStatus status;
-    FileManager fileManager;
-    SearchEngine searchEngine;
+    PlainSource raw;
+    ZSTD_DStream* stream;
+    vector<char> input;
+    ZSTD_inBuffer inBuffer;
+    size_t lastResult;
+    bool done;
+    bool error;
 
-    void updateModifiedStatus() 
-    {
-        fileManager.markAsModified();
+public:
+    ZstdSource(const string& filename) : raw(filename), stream(ZSTD_createDStream()),
+        input(ZSTD_DStreamInSize()), lastResult(0), done(false), error(false) {
+        inBuffer.src = input.data();
+        inBuffer.size = inBuffer.pos = 0;
+        if (!stream || ZSTD_isError(ZSTD_initDStream(stream))) error = done = true;
     }
 
-    bool isWordCharacter(char c) 
-    {
-        if ((c >= 'A' && c <= 'Z') || (c >= 'a' && c <= 'z') || (c >= '0' && c <= '9')) {
-            return true;
+    ~ZstdSource() {
+        if (stream) ZSTD_freeDStream(stream);
+    }
+
+    size_t read(char* out, size_t capacity) override {
+        ZSTD_outBuffer outBuffer = { out, capacity, 0 };
+        while (outBuffer.pos < outBuffer.size && !done) {
+            if (inBuffer.pos == inBuffer.size) {
+                size_t got = raw.read(input.data(), input.size());
+                if (got == 0) {
+                    done = true;
+                    error = lastResult != 0; // 0 means the last frame was complete
+                    break;
+                }
+                inBuffer.size = got;
+                inBuffer.pos = 0;
+            }
+            lastResult = ZSTD_decompressStream(stream, &outBuffer, &inBuffer);
+            if (ZSTD_isError(lastResult)) done = error = true;
         }
-        return false;
+        return outBuffer.pos;
+    }
+
+    long long consumed() const override {
+        return raw.consumed() - static_cast<long long>(inBuffer.size - inBuffer.pos);
+    }
+
+    bool failed() const override {
+        return error;
+    }
+};
+#endif
+
+class ByteSink {
+public:
+    virtual ~ByteSink() {}
+    virtual bool write(const char* data, size_t len) = 0;
+    // flushes any buffered or compressor state; must be called once at the end
+    virtual bool finish() = 0;
+};
+
+class PlainSink : public ByteSink {
+protected:
+    ofstream file;
+
+public:
+    PlainSink(const string& filename) : file(filename, ios::binary) {}
+
+    bool isOpen() const {
+        return file.is_open();
+    }
+
+    bool write(const char* data, size_t len) override {
+        file.write(data, len);
+        return static_cast<bool>(file);
+    }
+
+    bool finish() override {
+        file.flush();
+        return static_cast<bool>(file);
+    }
+};
+
+#ifdef TEXTEDITOR_ZLIB
+class GzipSink : public PlainSink {
+private:
+    z_stream stream;
+    vector<char> output;
+    bool ready;
+
+    bool pump(int flush) {
+        int result;
+        do {
+            stream.next_out = reinterpret_cast<Bytef*>(output.data());
+            stream.avail_out = static_cast<uInt>(output.size());
+            result = deflate(&stream, flush);
+            if (result == Z_STREAM_ERROR) return false;
+            if (!PlainSink::write(output.data(), output.size() - stream.avail_out)) return false;
+        } while (stream.avail_out == 0 || (flush == Z_FINISH && result != Z_STREAM_END));
+        return true;
+    }
+
+public:
+    GzipSink(const string& filename) : PlainSink(filename), output(1 << 16) {
+        memset(&stream, 0, sizeof(stream));
+        // 15 + 16: write a gzip header rather than zlib
+        ready = deflateInit2(&stream, Z_DEFAULT_COMPRESSION, Z_DEFLATED, 15 + 16, 8, Z_DEFAULT_STRATEGY) == Z_OK;
+    }
+
+    ~GzipSink() {
+        deflateEnd(&stream);
+    }
+
+    bool write(const char* data, size_t len) override {
+        if (!ready) return false;
+        stream.next_in = reinterpret_cast<Bytef*>(const_cast<char*>(data));
+        stream.avail_in = static_cast<uInt>(len);
+        return pump(Z_NO_FLUSH);
+    }
+
+    bool finish() override {
+        return ready && pump(Z_FINISH) && PlainSink::finish();
+    }
+};
+#endif
+
+#ifdef TEXTEDITOR_ZSTD
+class ZstdSink : public PlainSink {
+private:
+    ZSTD_CCtx* context;
+    vector<char> output;
+
+    bool pump(ZSTD_inBuffer& input, ZSTD_EndDirective mode) {
+        size_t remaining;
+        do {
+            ZSTD_outBuffer outBuffer = { output.data(), output.size(), 0 };
+            remaining = ZSTD_compressStream2(context, &outBuffer, &input, mode);
+            if (ZSTD_isError(remaining)) return false;
+            if (!PlainSink::write(output.data(), outBuffer.pos)) return false;
+        } while (mode == ZSTD_e_end ? remaining != 0 : input.pos < input.size);
+        return true;
+    }
+
+public:
+    ZstdSink(const string& filename) : PlainSink(filename), context(ZSTD_createCCtx()), output(ZSTD_CStreamOutSize()) {}
+
+    ~ZstdSink() {
+        if (context) ZSTD_freeCCtx(context);
+    }
+
+    bool write(const char* data, size_t len) override {
+        ZSTD_inBuffer input = { data, len, 0 };
+        return context && pump(input, ZSTD_e_continue);
+    }
+
+    bool finish() override {
+        ZSTD_inBuffer input = { nullptr, 0, 0 };
+        return context && pump(input, ZSTD_e_end) && PlainSink::finish();
+    }
+};
+#endif
+
+// Line diff over per-line hashes. The common prefix and suffix are stripped first and
+// what is left is bisected with Myers' O(ND) middle-snake search in linear space, so
+// comparing two nearly identical files costs little more than hashing them.
+class LineDiff {
+public:
+    enum Kind { SAME, REMOVED, ADDED };
+    struct Run {
+        Kind kind;
+        size_t oldLine; // where the run starts in each version
+        size_t newLine;
+        size_t count;
+    };
+
+    // 64-bit FNV-1a; a line read in pieces is hashed by feeding each piece to hashMore
+    static const uint64_t hashBasis = 14695981039346656037ull;
+
+    static uint64_t hashMore(uint64_t hash, const char* text, size_t len) {
+        for (size_t i = 0; i < len; ++i) {
+            hash = (hash ^ static_cast<unsigned char>(text[i])) * 1099511628211ull;
+        }
+        return hash;
+    }
+
+    static uint64_t hashLine(const char* text, size_t len) {
+        return hashMore(hashBasis, text, len);
+    }
+
+private:
+    const vector<uint64_t>& before;
+    const vector<uint64_t>& after;
+    vector<Run> result;
+
+    void add(Kind kind, size_t oldLine, size_t newLine, size_t count) {
+        if (count == 0) return;
+        if (!result.empty() && result.back().kind == kind) {
+            result.back().count += count;
+            return;
+        }
+        result.push_back({ kind, oldLine, newLine, count });
+    }
+
+    void compare(size_t oldFirst, size_t oldEnd, size_t newFirst, size_t newEnd) {
+        size_t prefix = 0;
+        while (oldFirst + prefix < oldEnd && newFirst + prefix < newEnd &&
+            before[oldFirst + prefix] == after[newFirst + prefix]) prefix++;
+        add(SAME, oldFirst, newFirst, prefix);
+        oldFirst += prefix;
+        newFirst += prefix;
+        size_t suffix = 0;
+        while (oldEnd - suffix > oldFirst && newEnd - suffix > newFirst &&
+            before[oldEnd - suffix - 1] == after[newEnd - suffix - 1]) suffix++;
+        oldEnd -= suffix;
+        newEnd -= suffix;
+        if (oldFirst == oldEnd || newFirst == newEnd) {
+            add(REMOVED, oldFirst, newFirst, oldEnd - oldFirst);
+            add(ADDED, oldEnd, newFirst, newEnd - newFirst);
+        }
+        else {
+            bisect(oldFirst, oldEnd, newFirst, newEnd);
+        }
+        add(SAME, oldEnd, newEnd, suffix);
+    }
+
+    // finds where the forward and backward searches meet and diffs either side of it
+    void bisect(size_t oldFirst, size_t oldEnd, size_t newFirst, size_t newEnd) {
+        const long long n = oldEnd - oldFirst, m = newEnd - newFirst;
+        const uint64_t* a = before.data() + oldFirst;
+        const uint64_t* b = after.data() + newFirst;
+        const long long maxD = (n + m + 1) / 2;
+        const long long offset = maxD + 1;
+        vector<long long> forward(2 * maxD + 3, -1), backward(2 * maxD + 3, -1);
+        forward[offset + 1] = backward[offset + 1] = 0;
+        const long long delta = n - m;
+        const bool odd = (delta & 1) != 0;
+        long long forwardStart = 0, forwardEnd = 0, backwardStart = 0, backwardEnd = 0;
+        for (long long d = 0; d < maxD; ++d) {
+            for (long long k = -d + forwardStart; k <= d - forwardEnd; k += 2) {
+                long long x = (k == -d || (k != d && forward[offset + k - 1] < forward[offset + k + 1]))
+                    ? forward[offset + k + 1] : forward[offset + k - 1] + 1;
+                long long y = x - k;
+                while (x < n && y < m && a[x] == b[y]) { x++; y++; }
+                forward[offset + k] = x;
+                if (x > n) forwardEnd += 2;
+                else if (y > m) forwardStart += 2;
+                else if (odd) {
+                    long long other = offset + delta - k;
+                    if (other >= 0 && other < static_cast<long long>(backward.size()) && backward[other] != -1 &&
+                        x >= n - backward[other]) {
+                        compare(oldFirst, oldFirst + x, newFirst, newFirst + y);
+                        compare(oldFirst + x, oldEnd, newFirst + y, newEnd);
+                        return;
+                    }
+                }
+            }
+            for (long long k = -d + backwardStart; k <= d - backwardEnd; k += 2) {
+                long long x = (k == -d || (k != d && backward[offset + k - 1] < backward[offset + k + 1]))
+                    ? backward[offset + k + 1] : backward[offset + k - 1] + 1;
+                long long y = x - k;
+                while (x < n && y < m && a[n - x - 1] == b[m - y - 1]) { x++; y++; }
+                backward[offset + k] = x;
+                if (x > n) backwardEnd += 2;
+                else if (y > m) backwardStart += 2;
+                else if (!odd) {
+                    long long other = offset + delta - k;
+                    if (other >= 0 && other < static_cast<long long>(forward.size()) && forward[other] != -1) {
+                        long long forwardX = forward[other];
+                        long long forwardY = forwardX - (other - offset);
+                        if (forwardX >= n - x) {
+                            compare(oldFirst, oldFirst + forwardX, newFirst, newFirst + forwardY);
+                            compare(oldFirst + forwardX, oldEnd, newFirst + forwardY, newEnd);
+                            return;
+                        }
+                    }
+                }
+            }
+        }
+        add(REMOVED, oldFirst, newFirst, n);
+        add(ADDED, oldEnd, newFirst, m);
+    }
+
+public:
+    LineDiff(const vector<uint64_t>& oldHashes, const vector<uint64_t>& newHashes) : before(oldHashes), after(newHashes) {
+        compare(0, before.size(), 0, after.size());
+    }
+
+    // runs in order, alternating between SAME and changed stretches
+    const vector<Run>& runs() const {
+        return result;
+    }
+};
+
+// Pages a large document in fixed-size blocks of whole lines. Every line keeps its
+// LinkedList header and statistics, so line numbers and counts stay exact, but only
+// resident blocks hold nodes. A cold block's text is read back from the original file
+// while the block is unedited, otherwise from a spill file; when resident blocks exceed
+// the memory cap the least recently used ones are paged out. Lines must be resident
+// before they are edited, inserted next to or erased.
+class LinePager {
+public:
+    static const size_t blockBytes = 256 * 1024;
+    // heap cost of one resident byte: its node plus the allocator's overhead
+    static const size_t nodeCost = sizeof(Node) + 16;
+    // blocks are cut by text size, so the cap cannot go below the two blocks that may have to
+    // stay resident together: the one on screen and the one holding the cursor
+    static const size_t minimumCap = 2 * blockBytes * nodeCost;
+
+private:
+    enum Backing { NO_COPY, ORIGINAL, SPILLED };
+    struct Block {
+        size_t lineCount;
+        size_t bytes; // text plus one newline per line
+        Backing backing;
+        long long offset; // of the copy in the original or spill file
+        bool resident;
+        bool dirty; // edited since the copy was written
+        size_t lastUsed;
+    };
+
+    vector<Block> blocks;
+    mutable vector<size_t> firstLines;
+    mutable bool firstLinesValid;
+    string original;
+    bool paging; // lines handed over by the loader are filed into blocks
+    bool coldLoad; // the loader hands over paged-out lines read from original
+    long long loadOffset;
+    FILE* spill;
+    long long spillEnd;
+    size_t memoryCap;
+    size_t residentBytes;
+    size_t useClock;
+    // hash of every line's current text, kept by the owner; it belongs to this slot, not to
+    // the document, so swap leaves it in place
+    const vector<uint64_t>* lineHashes;
+
+    static bool seekTo(FILE* file, long long offset) {
+#ifdef _WIN32
+        return _fseeki64(file, offset, SEEK_SET) == 0;
+#else
+        return fseeko(file, static_cast<off_t>(offset), SEEK_SET) == 0;
+#endif
+    }
+
+    size_t blockOf(size_t line) const {
+        if (!firstLinesValid) {
+            firstLines.resize(blocks.size());
+            size_t first = 0;
+            for (size_t b = 0; b < blocks.size(); ++b) {
+                firstLines[b] = first;
+                first += blocks[b].lineCount;
+            }
+            firstLinesValid = true;
+        }
+        return upper_bound(firstLines.begin(), firstLines.end(), line) - firstLines.begin() - 1;
+    }
+
+    size_t firstLineOf(size_t b) const {
+        blockOf(0);
+        return firstLines[b];
+    }
+
+    size_t countBytes(const vector<LinkedList>& lines, size_t first, size_t count) const {
+        size_t bytes = 0;
+        for (size_t i = first; i < first + count; ++i) {
+            bytes += lines[i].size() + 1;
+        }
+        return bytes;
+    }
+
+    void recount(const vector<LinkedList>& lines, size_t b) {
+        size_t bytes = countBytes(lines, firstLineOf(b), blocks[b].lineCount);
+        if (blocks[b].resident) residentBytes += bytes - blocks[b].bytes;
+        blocks[b].bytes = bytes;
+    }
+
+    Block newBlock(size_t lineCount, size_t bytes, bool resident) {
+        Block block = { lineCount, bytes, NO_COPY, 0, resident, resident, ++useClock };
+        if (resident) residentBytes += bytes;
+        return block;
+    }
+
+    // cuts a resident block that edits have grown past twice the block size
+    void splitLarge(const vector<LinkedList>& lines, size_t b) {
+        if (blocks[b].bytes <= 2 * blockBytes) return;
+        size_t line = firstLineOf(b);
+        size_t end = line + blocks[b].lineCount;
+        residentBytes -= blocks[b].bytes;
+        blocks.erase(blocks.begin() + b);
+        while (line < end) {
+            size_t count = 0, bytes = 0;
+            while (line + count < end && bytes < blockBytes) {
+                bytes += lines[line + count].size() + 1;
+                count++;
+            }
+            blocks.insert(blocks.begin() + b++, newBlock(count, bytes, true));
+            line += count;
+        }
+        firstLinesValid = false;
+    }
+
+    // the block's text as it was last written out, one newline per line
+    bool readCopy(const Block& block, string& text) const {
+        text.resize(block.bytes);
+        FILE* file = block.backing == ORIGINAL ? fopen(original.c_str(), "rb") : spill;
+        if (!file) return false;
+        size_t got = 0;
+        if (seekTo(file, block.offset)) got = fread(&text[0], 1, text.size(), file);
+        if (file != spill) fclose(file);
+        // the original file may not end its last line
+        if (got + 1 == text.size() && block.backing == ORIGINAL) text[got++] = '\n';
+        return got == text.size();
+    }
+
+    // the block's copy, if every line in it still ends where it did and hashes as it did
+    bool readLines(const vector<LinkedList>& lines, size_t b, string& text) const {
+        if (blocks[b].backing == NO_COPY || !readCopy(blocks[b], text)) return false;
+        bool hashed = lineHashes && lineHashes->size() == lines.size();
+        size_t pos = 0, first = firstLineOf(b);
+        for (size_t i = first; i < first + blocks[b].lineCount; ++i) {
+            size_t len = lines[i].size();
+            if (pos + len >= text.size() || text[pos + len] != '\n') return false;
+            if (hashed && LineDiff::hashLine(text.data() + pos, len) != (*lineHashes)[i]) return false;
+            pos += len + 1;
+        }
+        return true;
+    }
+
+    // a copy that no longer matches (the original changed on disk) leaves the block paged
+    // out: its lines then refuse edits and saves fail, rather than empty lines being written
+    bool loadBlock(vector<LinkedList>& lines, size_t b) {
+        Block& block = blocks[b];
+        size_t first = firstLineOf(b);
+        string text;
+        if (!readLines(lines, b, text)) return false;
+        size_t pos = 0;
+        for (size_t i = first; i < first + block.lineCount; ++i) {
+            size_t len = lines[i].size();
+            lines[i] = LinkedList::fromText(text.data() + pos, len);
+            pos += len + 1;
+        }
+        block.resident = true;
+        block.dirty = false;
+        residentBytes += block.bytes;
+        return true;
+    }
+
+    bool unloadBlock(vector<LinkedList>& lines, size_t b) {
+        Block& block = blocks[b];
+        size_t first = firstLineOf(b);
+        if (block.dirty || block.backing == NO_COPY) {
+            if (!spill) spill = tmpfile();
+            if (!spill || !seekTo(spill, spillEnd)) return false;
+            string text;
+            text.reserve(block.bytes);
+            for (size_t i = first; i < first + block.lineCount; ++i) {
+                text += lines[i].content();
+                text += '\n';
+            }
+            if (fwrite(text.data(), 1, text.size(), spill) != text.size()) return false;
+            block.backing = SPILLED;
+            block.offset = spillEnd;
+            spillEnd += text.size();
+        }
+        for (size_t i = first; i < first + block.lineCount; ++i) {
+            lines[i].pageOut();
+        }
+        block.resident = false;
+        block.dirty = false;
+        residentBytes -= block.bytes;
+        return true;
+    }
+
+    // pages out least recently used blocks outside [keepFirst, keepLast] and pinned
+    void enforceCap(vector<LinkedList>& lines, size_t keepFirst, size_t keepLast, size_t pinned) {
+        while (residentBytes * nodeCost > memoryCap) {
+            size_t victim = blocks.size();
+            for (size_t b = 0; b < blocks.size(); ++b) {
+                if (!blocks[b].resident || (b >= keepFirst && b <= keepLast) || b == pinned) continue;
+                if (victim == blocks.size() || blocks[b].lastUsed < blocks[victim].lastUsed) victim = b;
+            }
+            if (victim == blocks.size() || !unloadBlock(lines, victim)) break;
+        }
+    }
+
+public:
+    LinePager(size_t cap = 1024u * 1024 * 1024) : firstLinesValid(false), paging(false), coldLoad(false), loadOffset(0),
+        spill(nullptr), spillEnd(0), memoryCap(cap), residentBytes(0), useClock(0), lineHashes(nullptr) {}
+
+    LinePager(const LinePager&) = delete;
+    LinePager& operator=(const LinePager&) = delete;
+
+    LinePager(LinePager&& other) noexcept : LinePager() {
+        swap(other);
+    }
+
+    LinePager& operator=(LinePager&& other) noexcept {
+        swap(other);
+        return *this;
+    }
+
+    ~LinePager() {
+        if (spill) fclose(spill);
+    }
+
+    void swap(LinePager& other) noexcept {
+        blocks.swap(other.blocks);
+        firstLines.swap(other.firstLines);
+        std::swap(firstLinesValid, other.firstLinesValid);
+        original.swap(other.original);
+        std::swap(paging, other.paging);
+        std::swap(coldLoad, other.coldLoad);
+        std::swap(loadOffset, other.loadOffset);
+        std::swap(spill, other.spill);
+        std::swap(spillEnd, other.spillEnd);
+        std::swap(memoryCap, other.memoryCap);
+        std::swap(residentBytes, other.residentBytes);
+        std::swap(useClock, other.useClock);
+    }
+
+    bool enabled() const {
+        return !blocks.empty();
+    }
+
+    // copies read back are checked against these hashes, one per line
+    void verifyAgainst(const vector<uint64_t>* hashes) {
+        lineHashes = hashes;
+    }
+
+    // forgets the document; with paged set, lines appended next are filed into blocks,
+    // paged out and read back from sourceFile if it is given
+    void reset(const string& sourceFile, bool paged) {
+        blocks.clear();
+        firstLinesValid = false;
+        original = sourceFile;
+        paging = paged;
+        coldLoad = paged && !sourceFile.empty();
+        loadOffset = 0;
+        if (spill) fclose(spill);
+        spill = nullptr;
+        spillEnd = 0;
+        residentBytes = 0;
+    }
+
+    bool readsFrom(const string& filename) const {
+        return enabled() && !original.empty() && original == filename;
+    }
+
+    size_t cap() const {
+        return memoryCap;
+    }
+
+    void setCap(size_t cap) {
+        memoryCap = cap < minimumCap ? minimumCap : cap;
+    }
+
+    // files lines [first, end) handed over by the loader into blocks
+    void append(const vector<LinkedList>& lines, size_t first) {
+        if (!paging) return;
+        for (size_t i = first; i < lines.size(); ++i) {
+            size_t bytes = lines[i].size() + 1;
+            if (blocks.empty() || blocks.back().bytes >= blockBytes || blocks.back().dirty ||
+                blocks.back().resident == coldLoad || blocks.back().backing != (coldLoad ? ORIGINAL : NO_COPY)) {
+                blocks.push_back(newBlock(0, 0, !coldLoad));
+                blocks.back().dirty = false;
+                if (coldLoad) {
+                    blocks.back().backing = ORIGINAL;
+                    blocks.back().offset = loadOffset;
+                }
+            }
+            blocks.back().lineCount++;
+            blocks.back().bytes += bytes;
+            if (!coldLoad) residentBytes += bytes;
+            loadOffset += bytes;
+        }
+        firstLinesValid = false;
+    }
+
+    void lineEdited(const vector<LinkedList>& lines, size_t index) {
+        if (blocks.empty()) return;
+        size_t b = blockOf(index);
+        blocks[b].dirty = true;
+        recount(lines, b);
+        splitLarge(lines, b);
+    }
+
+    void lineInserted(const vector<LinkedList>& lines, size_t index, size_t count = 1) {
+        if (blocks.empty()) return;
+        // the new lines join the resident block before them, else the one after them, else
+        // get a block of their own, cutting a cold block in two at the line boundary
+        size_t b = blockOf(index > 0 ? index - 1 : 0);
+        if (!blocks[b].resident) {
+            size_t first = firstLines[b];
+            size_t before = index - first;
+            if (before > 0 && before < blocks[b].lineCount) {
+                Block tail = blocks[b];
+                size_t headBytes = countBytes(lines, first, before);
+                tail.lineCount -= before;
+                tail.bytes -= headBytes;
+                tail.offset += headBytes;
+                blocks[b].lineCount = before;
+                blocks[b].bytes = headBytes;
+                blocks.insert(blocks.begin() + b + 1, tail);
+            }
+            if (before == 0)
+                blocks.insert(blocks.begin() + b, newBlock(0, 0, true));
+            else if (b + 1 < blocks.size() && blocks[b + 1].resident)
+                b++;
+            else
+                blocks.insert(blocks.begin() + ++b, newBlock(0, 0, true));
+        }
+        blocks[b].lineCount += count;
+        blocks[b].dirty = true;
+        firstLinesValid = false;
+        recount(lines, b);
+        splitLarge(lines, b);
+    }
+
+    void lineErased(const vector<LinkedList>& lines, size_t index, size_t count = 1) {
+        if (blocks.empty()) return;
+        size_t b = blockOf(index);
+        size_t skipped = index - firstLines[b];
+        while (count > 0 && b < blocks.size()) {
+            size_t taken = min(count, blocks[b].lineCount - skipped);
+            skipped = 0;
+            blocks[b].lineCount -= taken;
+            blocks[b].dirty = true;
+            count -= taken;
+            if (blocks[b].lineCount == 0) {
+                if (blocks[b].resident) residentBytes -= blocks[b].bytes;
+                blocks.erase(blocks.begin() + b);
+            }
+            else {
+                b++;
+            }
+        }
+        firstLinesValid = false;
+        if (blocks.empty()) return;
+        size_t touched = min(blockOf(index > 0 ? index - 1 : 0), blocks.size() - 1);
+        for (size_t k = touched; k < min(touched + 2, blocks.size()); ++k) {
+            if (blocks[k].resident) recount(lines, k);
+        }
+    }
+
+    // makes lines [first, last] resident, then pages out blocks beyond the cap, never those
+    // lines nor the one holding pinned; false if a block could not be read back
+    bool pageIn(vector<LinkedList>& lines, size_t first, size_t last, size_t pinned) {
+        if (blocks.empty() || lines.empty()) return true;
+        last = min(last, lines.size() - 1);
+        size_t from = blockOf(first), to = blockOf(last);
+        bool ok = true;
+        bool loaded = false;
+        for (size_t b = from; b <= to; ++b) {
+            if (!blocks[b].resident) {
+                ok = loadBlock(lines, b) && ok;
+                loaded = true;
+            }
+            blocks[b].lastUsed = ++useClock;
+        }
+        if (loaded || residentBytes * nodeCost > memoryCap) enforceCap(lines, from, to, blockOf(pinned));
+        return ok;
+    }
+
+    // pages out every block it can, e.g. before the document is parked
+    void pageOutAll(vector<LinkedList>& lines) {
+        for (size_t b = 0; b < blocks.size(); ++b) {
+            if (blocks[b].resident) unloadBlock(lines, b);
+        }
+    }
+
+    // streams the document block by block, cold blocks straight from their copies
+    bool write(ByteSink& sink, const vector<LinkedList>& lines) const {
+        string text;
+        size_t first = 0;
+        for (size_t b = 0; b < blocks.size(); ++b) {
+            const Block& block = blocks[b];
+            if (block.resident) {
+                text.clear();
+                for (size_t i = first; i < first + block.lineCount; ++i) {
+                    text += lines[i].content();
+                    text += '\n';
+                }
+            }
+            else if (!readLines(lines, b, text)) {
+                return false;
+            }
+            if (!sink.write(text.data(), text.size())) return false;
+            first += block.lineCount;
+        }
+        return true;
+    }
+
+    struct CleanRun {
+        size_t firstLine;
+        size_t lineCount;
+        long long offset;
+    };
+
+    // stretches of lines that match the original file byte for byte from offset on
+    vector<CleanRun> cleanRuns() const {
+        vector<CleanRun> runs;
+        size_t first = 0;
+        for (const Block& block : blocks) {
+            if (block.backing == ORIGINAL && !block.dirty) runs.push_back({ first, block.lineCount, block.offset });
+            first += block.lineCount;
+        }
+        return runs;
+    }
+
+    // after a plain save every block has a clean copy in the file just written
+    void savedTo(const string& filename) {
+        original = filename;
+        coldLoad = false;
+        long long offset = 0;
+        for (Block& block : blocks) {
+            block.backing = ORIGINAL;
+            block.offset = offset;
+            block.dirty = false;
+            offset += block.bytes;
+        }
+        if (spill) fclose(spill);
+        spill = nullptr;
+        spillEnd = 0;
+    }
+
+    string describe() const {
+        size_t resident = 0;
+        for (const Block& block : blocks) resident += block.resident;
+        return to_string(resident) + " of " + to_string(blocks.size()) + " blocks resident, " +
+            to_string(residentBytes * nodeCost >> 20) + " of " + to_string(memoryCap >> 20) + " MB";
+    }
+};
+
+class FileManager {
+private:
+    string currentFileName;
+    bool modified;
+    bool readOnly; // a view such as :diff output, not backed by its file name
+    Compression compression;
+
+public:
+    // lines [firstLine, firstLine + lineCount) of the buffer, written at offset in the file
+    struct Patch {
+        size_t firstLine;
+        size_t lineCount;
+        long long offset;
+    };
+
+    FileManager() : modified(false), readOnly(false), compression(COMPRESSION_NONE) {}
+
+    static Compression detectCompression(const string& filename) {
+        ifstream file(filename, ios::binary);
+        unsigned char magic[4] = { 0, 0, 0, 0 };
+        file.read(reinterpret_cast<char*>(magic), 4);
+        if (file.gcount() >= 2 && magic[0] == 0x1F && magic[1] == 0x8B)
+            return COMPRESSION_GZIP;
+        if (file.gcount() == 4 && magic[0] == 0x28 && magic[1] == 0xB5 && magic[2] == 0x2F && magic[3] == 0xFD)
+            return COMPRESSION_ZSTD;
+        return COMPRESSION_NONE;
+    }
+
+    static Compression compressionForName(const string& filename) {
+        size_t dot = filename.rfind('.');
+        string ext = dot == string::npos ? "" : filename.substr(dot + 1);
+        if (ext == "gz") return COMPRESSION_GZIP;
+        if (ext == "zst") return COMPRESSION_ZSTD;
+        return COMPRESSION_NONE;
+    }
+
+    static unique_ptr<ByteSource> openSource(const string& filename, string& error) {
+        Compression format = detectCompression(filename);
+        if (format == COMPRESSION_NONE) {
+            unique_ptr<PlainSource> source(new PlainSource(filename));
+            if (!source->isOpen()) {
+                error = "Cannot open " + filename;
+                return nullptr;
+            }
+            return unique_ptr<ByteSource>(source.release());
+        }
+#ifdef TEXTEDITOR_ZLIB
+        if (format == COMPRESSION_GZIP) return unique_ptr<ByteSource>(new GzipSource(filename));
+#endif
+#ifdef TEXTEDITOR_ZSTD
+        if (format == COMPRESSION_ZSTD) return unique_ptr<ByteSource>(new ZstdSource(filename));
+#endif
+        error = filename + (format == COMPRESSION_GZIP ? ": gzip" : ": zstd") + " support is not built in";
+        return nullptr;
+    }
+
+    static unique_ptr<ByteSink> openSink(const string& filename, Compression format) {
+        PlainSink* sink = nullptr;
+        if (format == COMPRESSION_NONE) sink = new PlainSink(filename);
+#ifdef TEXTEDITOR_ZLIB
+        if (format == COMPRESSION_GZIP) sink = new GzipSink(filename);
+#endif
+#ifdef TEXTEDITOR_ZSTD
+        if (format == COMPRESSION_ZSTD) sink = new ZstdSink(filename);
+#endif
+        if (sink && !sink->isOpen()) {
+            delete sink;
+            sink = nullptr;
+        }
+        return unique_ptr<ByteSink>(sink);
+    }
+
+    bool loadFile(const std::string& filename) {
+        ifstream file(filename);
+        if (!file.is_open()) {
+            return false;
+        }
+        currentFileName = filename;
+        modified = false;
+        readOnly = false;
+        compression = detectCompression(filename);
+        return true;
+    }
+
+    bool saveFile(const std::string& filename, const std::vector<LinkedList>& lines, LinePager* pager = nullptr) {
+        // keep the format the file was loaded in unless the new name asks for another
+        Compression format = compressionForName(filename);
+        if (format == COMPRESSION_NONE && filename == currentFileName) format = compression;
+        bool paged = pager && pager->enabled();
+        // cold blocks are still read from the file being replaced, so write beside it first
+        string target = paged && pager->readsFrom(filename) ? filename + "~" : filename;
+        // recompressing it in place would leave the cold blocks nothing to be read from
+        if (target != filename && format != COMPRESSION_NONE) return false;
+        unique_ptr<ByteSink> sink = openSink(target, format);
+        if (!sink) {
+            return false;
+        }
+        if (paged) {
+            if (!pager->write(*sink, lines) || !sink->finish()) {
+                sink.reset();
+                if (target != filename) remove(target.c_str());
+                return false;
+            }
+        }
+        else {
+            string block;
+            for (const auto& line : lines) {
+                block += line.content();
+                block += '\n';
+                if (block.size() >= (1 << 20)) {
+                    if (!sink->write(block.data(), block.size())) return false;
+                    block.clear();
+                }
+            }
+            if (!sink->write(block.data(), block.size()) || !sink->finish()) {
+                return false;
+            }
+        }
+        sink.reset();
+        if (target != filename) {
+#ifdef _WIN32
+            remove(filename.c_str());
+#endif
+            if (rename(target.c_str(), filename.c_str()) != 0) return false;
+        }
+        if (paged && format == COMPRESSION_NONE) pager->savedTo(filename);
+        currentFileName = filename;
+        modified = false;
+        readOnly = false;
+        compression = format;
+        return true;
+    }
+
+    // overwrites the patched lines where they sit in the current plain file instead of writing
+    // it out whole; refused when the file no longer has the length the patches were made for.
+    // A paged document has each patch paged in just before it is written
+    bool patchFile(const std::string& filename, long long fileBytes, std::vector<LinkedList>& lines,
+        const vector<Patch>& patches, LinePager* pager = nullptr) {
+        if (filename != currentFileName || compression != COMPRESSION_NONE) return false;
+        fstream file(filename, ios::in | ios::out | ios::binary);
+        if (!file.is_open() || !file.seekg(0, ios::end) || static_cast<long long>(file.tellg()) != fileBytes) {
+            return false;
+        }
+        for (const Patch& patch : patches) {
+            size_t last = patch.firstLine + patch.lineCount - 1;
+            if (pager && pager->enabled() && !pager->pageIn(lines, patch.firstLine, last, patch.firstLine)) return false;
+            if (!file.seekp(patch.offset)) return false;
+            string block;
+            for (size_t i = patch.firstLine; i < patch.firstLine + patch.lineCount; ++i) {
+                block += lines[i].content();
+                block += '\n';
+                if (block.size() >= (1 << 20)) {
+                    if (!file.write(block.data(), block.size())) return false;
+                    block.clear();
+                }
+            }
+            if (!file.write(block.data(), block.size())) return false;
+        }
+        if (!file.flush()) return false;
+        modified = false;
+        return true;
+    }
+
+    bool isCompressed() const {
+        return compression != COMPRESSION_NONE;
+    }
+
+    bool hasUnsavedChanges() const {
+        return modified;
+    }
+
+    void markAsModified() {
+        modified = true;
+    }
+
+    void clearModified() {
+        modified = false;
+    }
+
+    bool isReadOnly() const {
+        return readOnly;
+    }
+
+    string getCurrentFileName() const {
+        return currentFileName.empty() ? "[No File]" : currentFileName;
+    }
+
+    bool hasFileName() const {
+        return !currentFileName.empty();
+    }
+
+    void setCurrentFile(const string& filename, bool isModified, bool isView = false) {
+        currentFileName = filename;
+        modified = isModified;
+        readOnly = isView;
+        compression = filename.empty() ? COMPRESSION_NONE : detectCompression(filename);
+    }
+};
+
+class SearchEngine {
+private:
+    string lastPattern;
+    size_t lastMatchLine;
+    size_t lastMatchColumn;
+
+public:
+    SearchEngine() : lastPattern(""), lastMatchLine(0), lastMatchColumn(0) {}
+
+    bool search(const string& pattern, vector<LinkedList>& lines, int& currentLine, LinkedList::Iterator& charCursor,int cursorPos,
+        LinePager* pager = nullptr) 
+    {
+        lastPattern = pattern;
+        string content = lines[currentLine].getLineContent();
+
+        size_t pos = content.find(pattern, cursorPos);
+        if (pos != string::npos) {
+            charCursor = lines[currentLine].begin();
+            for (size_t j = 0; j < pos; ++j) {
+                ++charCursor;
+            }
+            lastMatchLine = currentLine;
+            lastMatchColumn = pos;
+            return true;
+        }
+
+        for (int i = currentLine + 1; i < lines.size(); ++i) {
+            if (pager) pager->pageIn(lines, i, i, currentLine);
+            content = lines[i].getLineContent();
+            pos = content.find(pattern);
+            if (pos != string::npos) {
+                currentLine = i;
+                charCursor = lines[i].begin();
+                for (size_t j = 0; j < pos; ++j) {
+                    ++charCursor;
+                }
+                lastMatchLine = i;
+                lastMatchColumn = pos;
+                return true;
+            }
+        }
+        return false;
+    }
+
+
+    bool findNext(vector<LinkedList>& lines, int& currentLine, LinkedList::Iterator& charCursor,int cursorPos,
+        LinePager* pager = nullptr) 
+    {
+        if (lastPattern.empty()) return false;
+        return search(lastPattern, lines, currentLine, charCursor, cursorPos, pager);
+    }
+
+    bool findPrevious(vector<LinkedList>& lines, int& currentLine, LinkedList::Iterator& charCursor,int cursorPos) 
+    {
+        if (lastPattern.empty()) return false;
+
+        string content = lines[currentLine].getLineContent();
+
+        size_t pos = content.rfind(lastPattern, cursorPos - 2);
+        if (pos != string::npos) {
+            charCursor = lines[currentLine].begin();
+            for (size_t j = 0; j < pos; ++j) {
+                ++charCursor;
+            }
+            lastMatchLine = currentLine;
+            lastMatchColumn = pos;
+            return true;
+        }
+        return false;
+    }
+
+    bool replace(const string& old, const string& newStr, LinkedList& line, bool global = false) 
+    {
+        string content = line.getLineContent();
+        size_t pos = content.find(old);
+        if (pos == string::npos) return false;
+
+        while (pos != string::npos) {
+            line.deleteLine();
+            LinkedList::Iterator iter = line.end();
+            for (size_t i = 0; i < pos; ++i) {
+                line.insertChar(iter, content[i]);
+            }
+            for (char ch : newStr) {
+                line.insertChar(iter, ch);
+            }
+            for (size_t i = pos + old.size(); i < content.size(); ++i) {
+                line.insertChar(iter, content[i]);
+            }
+
+            if (!global) break;
+            content = line.getLineContent();
+            pos = content.find(old, pos + newStr.size());
+        }
+        return true;
+    }
+};
+
+// Per-line statistics mirrored in a Fenwick tree. Totals are kept exactly on every
+// update; the tree itself is rebuilt lazily after lines are inserted or removed.
+class LineStatsTree {
+private:
+    vector<LineStats> values;
+    mutable vector<LineStats> tree;
+    mutable bool stale;
+    LineStats total;
+
+    void rebuildTree() const {
+        tree.assign(values.size() + 1, LineStats());
+        for (size_t i = 1; i <= values.size(); ++i) {
+            tree[i] += values[i - 1];
+            size_t parent = i + (i & (0 - i));
+            if (parent <= values.size()) tree[parent] += tree[i];
+        }
+        stale = false;
+    }
+
+    LineStats prefix(size_t count) const {
+        LineStats sum;
+        for (size_t i = count; i > 0; i -= i & (0 - i)) {
+            sum += tree[i];
+        }
+        return sum;
+    }
+
+public:
+    LineStatsTree() : stale(true) {}
+
+    void reset(const vector<LinkedList>& lines) {
+        values.clear();
+        total = LineStats();
+        for (const auto& line : lines) {
+            values.push_back(line.getStats());
+            total += line.getStats();
+        }
+        stale = true;
+    }
+
+    void update(size_t index, const LineStats& newStats) {
+        if (index >= values.size()) return;
+        LineStats delta = newStats;
+        delta -= values[index];
+        total -= values[index];
+        total += newStats;
+        values[index] = newStats;
+        if (stale) return;
+        // unsigned wrap-around makes negative deltas add correctly
+        for (size_t i = index + 1; i < tree.size(); i += i & (0 - i)) {
+            tree[i] += delta;
+        }
+    }
+
+    // records lines[index, index + count) as newly inserted
+    void insert(size_t index, const vector<LinkedList>& lines, size_t count = 1) {
+        vector<LineStats> added;
+        added.reserve(count);
+        for (size_t i = index; i < index + count; ++i) {
+            added.push_back(lines[i].getStats());
+            total += lines[i].getStats();
+        }
+        values.insert(values.begin() + index, added.begin(), added.end());
+        stale = true;
+    }
+
+    void erase(size_t index, size_t count = 1) {
+        if (index >= values.size()) return;
+        count = min(count, values.size() - index);
+        for (size_t i = index; i < index + count; ++i) {
+            total -= values[i];
+        }
+        values.erase(values.begin() + index, values.begin() + index + count);
+        stale = true;
+    }
+
+    const LineStats& totals() const {
+        return total;
+    }
+
+    size_t lineCount() const {
+        return values.size();
+    }
+
+    // statistics of lines [first, last)
+    LineStats range(size_t first, size_t last) const {
+        if (stale) rebuildTree();
+        LineStats sum = prefix(last);
+        sum -= prefix(first);
+        return sum;
+    }
+};
+
+// Line positions that follow their lines through edits, for marks and the jump list.
+// The lines are an implicit treap of pieces: each anchored line is a piece of its own and
+// each stretch of lines between anchors is one run piece, so the tree is only as large as
+// the number of anchors. An insert or erase adjusts run lengths along one root path and an
+// anchor's line number is the weight to its left, both O(log n); no anchor is ever rescanned.
+class LineAnchors {
+public:
+    static const size_t NONE = SIZE_MAX;
+
+private:
+    struct Piece {
+        size_t weight; // lines covered; 1 for an anchor
+        size_t total; // weight of the subtree
+        unsigned int priority;
+        bool anchor;
+        bool erased; // an anchor whose line was deleted
+        int refs;
+        Piece* left;
+        Piece* right;
+        Piece* parent;
+    };
+
+    Piece* root;
+    vector<Piece*> handles;
+    vector<size_t> freeHandles;
+    unsigned int seed;
+
+    static size_t total(const Piece* piece) {
+        return piece ? piece->total : 0;
+    }
+
+    Piece* newPiece(size_t weight) {
+        seed ^= seed << 13;
+        seed ^= seed >> 17;
+        seed ^= seed << 5;
+        return new Piece{ weight, weight, seed, false, false, 0, nullptr, nullptr, nullptr };
+    }
+
+    static void pull(Piece* piece) {
+        piece->total = piece->weight + total(piece->left) + total(piece->right);
+        if (piece->left) piece->left->parent = piece;
+        if (piece->right) piece->right->parent = piece;
+    }
+
+    static Piece* merge(Piece* a, Piece* b) {
+        if (!a || !b) return a ? a : b;
+        if (a->priority > b->priority) {
+            a->right = merge(a->right, b);
+            pull(a);
+            return a;
+        }
+        b->left = merge(a, b->left);
+        pull(b);
+        return b;
+    }
+
+    // left receives the first count lines, cutting a run in two if it straddles the boundary
+    void split(Piece* piece, size_t count, Piece*& left, Piece*& right) {
+        if (!piece) {
+            left = right = nullptr;
+            return;
+        }
+        size_t before = total(piece->left);
+        if (count <= before) {
+            split(piece->left, count, left, piece->left);
+            pull(piece);
+            right = piece;
+        }
+        else if (count >= before + piece->weight) {
+            split(piece->right, count - before - piece->weight, piece->right, right);
+            pull(piece);
+            left = piece;
+        }
+        else {
+            Piece* rest = newPiece(before + piece->weight - count);
+            piece->weight = count - before;
+            Piece* after = piece->right;
+            piece->right = nullptr;
+            pull(piece);
+            right = merge(rest, after);
+            left = piece;
+        }
+        if (left) left->parent = nullptr;
+        if (right) right->parent = nullptr;
+    }
+
+    // piece holding the given line, and the line's offset within it
+    Piece* locate(size_t line, size_t& offset) const {
+        Piece* piece = root;
+        while (piece) {
+            size_t before = total(piece->left);
+            if (line < before) {
+                piece = piece->left;
+            }
+            else if (line < before + piece->weight) {
+                offset = line - before;
+                return piece;
+            }
+            else {
+                line -= before + piece->weight;
+                piece = piece->right;
+            }
+        }
+        return nullptr;
+    }
+
+    static void resize(Piece* piece, size_t weight) {
+        size_t old = piece->weight;
+        piece->weight = weight;
+        for (Piece* up = piece; up; up = up->parent) up->total = up->total - old + weight;
+    }
+
+    void detach(Piece* piece) {
+        Piece* joined = merge(piece->left, piece->right);
+        Piece* parent = piece->parent;
+        if (joined) joined->parent = parent;
+        if (!parent) root = joined;
+        else if (parent->left == piece) parent->left = joined;
+        else parent->right = joined;
+        for (Piece* up = parent; up; up = up->parent) up->total -= piece->weight;
+        piece->left = piece->right = piece->parent = nullptr;
+        if (piece->anchor && piece->refs > 0) piece->erased = true;
+        else delete piece;
+    }
+
+    // folds the run starting at line into the run ending just before it, so that no two
+    // runs are ever neighbours and the tree stays as small as the number of anchors
+    void joinRunsAt(size_t line) {
+        if (line == 0 || line >= total(root)) return;
+        size_t offset = 0;
+        Piece* before = locate(line - 1, offset);
+        Piece* after = locate(line, offset);
+        if (before == after || before->anchor || after->anchor) return;
+        size_t weight = after->weight;
+        detach(after);
+        resize(before, before->weight + weight);
+    }
+
+    void destroy(Piece* piece) {
+        if (!piece) return;
+        destroy(piece->left);
+        destroy(piece->right);
+        delete piece;
+    }
+
+    static size_t countPieces(const Piece* piece) {
+        return piece ? 1 + countPieces(piece->left) + countPieces(piece->right) : 0;
+    }
+
+    size_t lineOfPiece(const Piece* piece) const {
+        size_t line = total(piece->left);
+        for (; piece->parent; piece = piece->parent) {
+            if (piece == piece->parent->right) line += total(piece->parent->left) + piece->parent->weight;
+        }
+        return line;
+    }
+
+public:
+    LineAnchors() : root(nullptr), seed(2463534242u) {}
+
+    LineAnchors(const LineAnchors&) = delete;
+    LineAnchors& operator=(const LineAnchors&) = delete;
+
+    ~LineAnchors() {
+        reset(0);
+    }
+
+    // a new document: every handle is released
+    void reset(size_t lineCount) {
+        // erased anchors live outside the tree; the rest go with it
+        for (Piece* piece : handles) {
+            if (piece && piece->erased && --piece->refs == 0) delete piece;
+        }
+        destroy(root);
+        handles.clear();
+        freeHandles.clear();
+        root = lineCount > 0 ? newPiece(lineCount) : nullptr;
+    }
+
+    void insert(size_t index, size_t count = 1) {
+        if (count == 0) return;
+        size_t lines = total(root);
+        size_t offset = 0;
+        // grow the run the lines land in, or the run just before them
+        Piece* piece = index < lines ? locate(index, offset) : nullptr;
+        if (piece && !piece->anchor) {
+            resize(piece, piece->weight + count);
+            return;
+        }
+        piece = index > 0 ? locate(min(index, lines) - 1, offset) : nullptr;
+        if (piece && !piece->anchor) {
+            resize(piece, piece->weight + count);
+            return;
+        }
+        Piece *left, *right;
+        split(root, index, left, right);
+        root = merge(merge(left, newPiece(count)), right);
+        root->parent = nullptr;
+    }
+
+    void erase(size_t index, size_t count = 1) {
+        while (count > 0 && index < total(root)) {
+            size_t offset = 0;
+            Piece* piece = locate(index, offset);
+            size_t taken = min(count, piece->weight - offset);
+            count -= taken;
+            if (taken == piece->weight) detach(piece);
+            else resize(piece, piece->weight - taken);
+        }
+        // the runs on either side of an erased anchor now touch
+        joinRunsAt(index);
+    }
+
+    // a handle that keeps reporting this line's number until the line is deleted
+    size_t add(size_t line) {
+        if (!root) return NONE;
+        line = min(line, total(root) - 1);
+        Piece *left, *middle, *right;
+        split(root, line, left, middle);
+        split(middle, 1, middle, right);
+        middle->anchor = true;
+        middle->refs++;
+        root = merge(merge(left, middle), right);
+        root->parent = nullptr;
+        size_t handle = handles.size();
+        if (!freeHandles.empty()) {
+            handle = freeHandles.back();
+            freeHandles.pop_back();
+            handles[handle] = middle;
+        }
+        else {
+            handles.push_back(middle);
+        }
+        return handle;
+    }
+
+    void release(size_t handle) {
+        if (handle >= handles.size() || !handles[handle]) return;
+        Piece* piece = handles[handle];
+        handles[handle] = nullptr;
+        freeHandles.push_back(handle);
+        if (--piece->refs > 0) return;
+        if (piece->erased) {
+            delete piece;
+            return;
+        }
+        // the line becomes a run again and joins the runs on both sides of it
+        piece->anchor = false;
+        size_t line = lineOfPiece(piece);
+        joinRunsAt(line + 1);
+        joinRunsAt(line);
+    }
+
+    // false once the anchored line has been deleted
+    bool lineOf(size_t handle, size_t& line) const {
+        if (handle >= handles.size() || !handles[handle] || handles[handle]->erased) return false;
+        line = lineOfPiece(handles[handle]);
+        return true;
+    }
+
+    // size of the tree, at most one run on either side of every anchored line
+    size_t pieces() const {
+        return countPieces(root);
+    }
+
+    void swap(LineAnchors& other) {
+        std::swap(root, other.root);
+        handles.swap(other.handles);
+        freeHandles.swap(other.freeHandles);
+        std::swap(seed, other.seed);
+    }
+};
+
+// a place that follows its line through edits: a LineAnchors handle and a byte offset
+struct Position {
+    size_t anchor;
+    size_t offset;
+};
+
+// What the file on disk holds and which buffer lines still match it. Every buffer line
+// keeps a hash of its current text, updated by the same hooks as the other per-line
+// state; a line is dirty while its hash differs from the disk line at its index. Edits
+// undone by hand therefore leave the buffer clean again, and a save can overwrite just
+// the dirty lines when none of them changed length. The count of dirty lines is kept
+// exactly through edits. Inserting or removing lines leaves a stale stretch between the
+// lines above it, still compared by index, and the lines below it, compared counting
+// from the end; only that stretch is recounted once the line counts agree again.
+class DiskBaseline {
+private:
+    vector<uint64_t> hashes; // current text of each buffer line
+    vector<uint64_t> diskHashes; // each line of the file as last loaded or saved
+    vector<long long> diskStarts; // offset of each disk line, then the offset past the last newline
+    bool terminated; // the file ends in a newline, as a save would write it
+    bool known; // false until a file is read in whole
+    mutable size_t dirtyLines; // dirty lines outside the stale stretch
+    mutable bool stale;
+    size_t staleFrom; // first line of the stale stretch
+    size_t staleTail; // lines below the stale stretch
+
+    static uint64_t hashOf(const LinkedList& line) {
+        const string& text = line.content();
+        return LineDiff::hashLine(text.data(), text.size());
+    }
+
+    bool isDirty(size_t index) const {
+        return index >= diskHashes.size() || hashes[index] != diskHashes[index];
+    }
+
+    size_t tailStart() const {
+        return hashes.size() - staleTail;
+    }
+
+    // whether a line outside the stale stretch differs from the disk line it lines up with
+    bool countedDirty(size_t index) const {
+        if (stale && index >= tailStart()) return hashes[index] != diskHashes[diskHashes.size() - (hashes.size() - index)];
+        return isDirty(index);
+    }
+
+    // widens the stale stretch to cover lines [first, end), taking them out of the count
+    void markStale(size_t first, size_t end) {
+        if (!stale) {
+            stale = true;
+            staleFrom = first;
+            staleTail = hashes.size() - first;
+        }
+        for (size_t i = first; i < staleFrom; ++i) dirtyLines -= countedDirty(i);
+        staleFrom = min(staleFrom, first);
+        size_t tail = tailStart();
+        for (size_t i = tail; i < end; ++i) dirtyLines -= countedDirty(i);
+        if (end > tail) staleTail = hashes.size() - end;
+    }
+
+    // the line counts agree, so the stale stretch compares by index like the rest
+    void recount() const {
+        for (size_t i = staleFrom; i < tailStart(); ++i) {
+            dirtyLines += isDirty(i);
+        }
+        stale = false;
+    }
+
+public:
+    DiskBaseline() : diskStarts(1, 0), terminated(true), known(false), dirtyLines(0), stale(false),
+        staleFrom(0), staleTail(0) {}
+
+    // starts over for a file about to be loaded
+    void reset() {
+        hashes.clear();
+        diskHashes.clear();
+        diskStarts.assign(1, 0);
+        terminated = true;
+        known = true;
+        dirtyLines = 0;
+        stale = false;
+    }
+
+    // a partial load, a followed file or a view: buffer and file can no longer be compared
+    void forget() {
+        known = false;
+    }
+
+    // text with no file behind it; its lines are tracked so a later save has them hashed
+    void detach(const vector<LinkedList>& lines) {
+        hashes.clear();
+        hashes.reserve(lines.size());
+        for (const auto& line : lines) hashes.push_back(hashOf(line));
+        diskHashes.clear();
+        diskStarts.assign(1, 0);
+        terminated = true;
+        known = false;
+        dirtyLines = 0;
+        // every line is in the stale stretch, as nothing lines up with a disk file
+        stale = true;
+        staleFrom = 0;
+        staleTail = 0;
+    }
+
+    bool isKnown() const {
+        return known;
+    }
+
+    const vector<uint64_t>& lineHashes() const {
+        return hashes;
+    }
+
+    // whether fileHashes, one per line of the file as it is now, are what was last loaded or saved
+    bool describes(const vector<uint64_t>& fileHashes) const {
+        return known && fileHashes == diskHashes;
+    }
+
+    // lines [first, end) came from the file; lineHashes are the loader's hashes of their text
+    void loaded(const vector<LinkedList>& lines, size_t first, const vector<uint64_t>& lineHashes) {
+        for (size_t i = first; i < lines.size(); ++i) {
+            diskStarts.push_back(diskStarts.back() + static_cast<long long>(lines[i].getStats().bytes) + 1);
+        }
+        hashes.insert(hashes.end(), lineHashes.begin(), lineHashes.end());
+        diskHashes.insert(diskHashes.end(), lineHashes.begin(), lineHashes.end());
+        // appended to both sides, so lines below a stale stretch still line up from the end
+        if (stale) staleTail += lineHashes.size();
+        for (size_t i = hashes.size() - lineHashes.size(); i < hashes.size(); ++i) {
+            dirtyLines += countedDirty(i);
+        }
+    }
+
+    void setTerminated(bool endsInNewline) {
+        terminated = endsInNewline;
+    }
+
+    // after a save the file holds exactly the buffer; paged-out lines were written unchanged
+    void saved(const vector<LinkedList>& lines) {
+        hashes.resize(lines.size());
+        for (size_t i = 0; i < lines.size(); ++i) {
+            if (!lines[i].isPagedOut()) hashes[i] = hashOf(lines[i]);
+        }
+        diskHashes = hashes;
+        diskStarts.assign(1, 0);
+        diskStarts.reserve(lines.size() + 1);
+        for (const auto& line : lines) {
+            diskStarts.push_back(diskStarts.back() + static_cast<long long>(line.getStats().bytes) + 1);
+        }
+        terminated = true;
+        known = true;
+        dirtyLines = 0;
+        stale = false;
+    }
+
+    void lineEdited(const vector<LinkedList>& lines, size_t index) {
+        // a paged-out line refused the edit, so its text and hash are unchanged
+        if (index >= hashes.size() || lines[index].isPagedOut()) return;
+        if (stale && index >= staleFrom && index < tailStart()) {
+            hashes[index] = hashOf(lines[index]);
+            return;
+        }
+        bool wasDirty = countedDirty(index);
+        hashes[index] = hashOf(lines[index]);
+        dirtyLines = dirtyLines - wasDirty + countedDirty(index);
+    }
+
+    void lineInserted(const vector<LinkedList>& lines, size_t index, size_t count = 1) {
+        vector<uint64_t> added;
+        added.reserve(count);
+        for (size_t i = index; i < index + count; ++i) {
+            added.push_back(hashOf(lines[i]));
+        }
+        index = min(index, hashes.size());
+        markStale(index, index);
+        hashes.insert(hashes.begin() + index, added.begin(), added.end());
+    }
+
+    void lineErased(size_t index, size_t count = 1) {
+        if (index >= hashes.size()) return;
+        count = min(count, hashes.size() - index);
+        markStale(index, index + count);
+        hashes.erase(hashes.begin() + index, hashes.begin() + index + count);
+    }
+
+    // an empty file loads as one empty line
+    bool matchesDisk() const {
+        if (!known) return false;
+        if (diskHashes.empty()) return hashes.size() == 1 && hashes[0] == LineDiff::hashBasis;
+        if (hashes.size() != diskHashes.size()) return false;
+        if (stale) recount();
+        return dirtyLines == 0;
+    }
+
+    // length of the file as last loaded or saved
+    long long fileBytes() const {
+        return diskStarts.back() - (terminated ? 0 : 1);
+    }
+
+    // stretches of dirty lines to overwrite in place, or false when the line count or some
+    // dirty line's length changed and the file has to be written out whole
+    bool patches(const vector<LinkedList>& lines, vector<FileManager::Patch>& out) const {
+        if (!known || !terminated || hashes.size() != diskHashes.size() || lines.size() != hashes.size()) return false;
+        for (size_t i = 0; i < hashes.size(); ++i) {
+            if (!isDirty(i)) continue;
+            if (static_cast<long long>(lines[i].getStats().bytes) + 1 != diskStarts[i + 1] - diskStarts[i]) return false;
+            if (!out.empty() && out.back().firstLine + out.back().lineCount == i)
+                out.back().lineCount++;
+            else
+                out.push_back({ i, 1, diskStarts[i] });
+        }
+        return true;
+    }
+
+    void swap(DiskBaseline& other) {
+        hashes.swap(other.hashes);
+        diskHashes.swap(other.diskHashes);
+        diskStarts.swap(other.diskStarts);
+        std::swap(terminated, other.terminated);
+        std::swap(known, other.known);
+        std::swap(dirtyLines, other.dirtyLines);
+        std::swap(stale, other.stale);
+        std::swap(staleFrom, other.staleFrom);
+        std::swap(staleTail, other.staleTail);
+    }
+};
+
+// A highlighter colors one line given the lexer state at the end of the previous line
+// and returns the state at the end of this one. colors may be null when only the state is needed.
+class Highlighter {
+public:
+    virtual ~Highlighter() {}
+    virtual int highlight(const string& text, int state, vector<unsigned char>* colors) const = 0;
+
+protected:
+    static void paint(vector<unsigned char>* colors, size_t from, size_t to, unsigned char color) {
+        if (!colors) return;
+        for (size_t i = from; i < to; ++i) (*colors)[i] = color;
+    }
+
+    static bool isIdentifierByte(char c) {
+        return isWordByte(c) || c == '_';
+    }
+
+    // end of the quoted string opened at text[pos], or the end of the line
+    static size_t skipQuoted(const string& text, size_t pos) {
+        char quote = text[pos];
+        size_t i = pos + 1;
+        while (i < text.size() && text[i] != quote) {
+            if (text[i] == '\\') i++;
+            i++;
+        }
+        return min(i + 1, text.size());
+    }
+};
+
+class CLikeHighlighter : public Highlighter {
+private:
+    enum State { NORMAL, BLOCK_COMMENT };
+
+    static bool isKeyword(const string& text, size_t from, size_t to) {
+        static const char* const keywords[] = {
+            "auto", "bool", "break", "case", "catch", "char", "class", "const", "constexpr", "continue",
+            "default", "delete", "do", "double", "else", "enum", "explicit", "false", "float", "for",
+            "friend", "if", "inline", "int", "long", "namespace", "new", "nullptr", "operator", "private",
+            "protected", "public", "return", "short", "signed", "size_t", "sizeof", "static", "string",
+            "struct", "switch", "template", "this", "throw", "true", "try", "typedef", "typename", "union",
+            "unsigned", "using", "virtual", "void", "volatile", "while"
+        };
+        string_view word(text.data() + from, to - from);
+        return binary_search(begin(keywords), end(keywords), word,
+            [](string_view a, string_view b) { return a < b; });
+    }
+
+public:
+    int highlight(const string& text, int state, vector<unsigned char>* colors) const override {
+        if (colors) colors->assign(text.size(), TC_DEFAULT);
+        size_t i = 0;
+        size_t n = text.size();
+        while (i < n) {
+            if (state == BLOCK_COMMENT) {
+                size_t close = text.find("*/", i);
+                size_t stop = close == string::npos ? n : close + 2;
+                paint(colors, i, stop, TC_COMMENT);
+                if (close != string::npos) state = NORMAL;
+                i = stop;
+                continue;
+            }
+            char c = text[i];
+            if (c == '/' && i + 1 < n && text[i + 1] == '/') {
+                paint(colors, i, n, TC_COMMENT);
+                break;
+            }
+            if (c == '/' && i + 1 < n && text[i + 1] == '*') {
+                paint(colors, i, i + 2, TC_COMMENT);
+                state = BLOCK_COMMENT;
+                i += 2;
+            }
+            else if (c == '"' || c == '\'') {
+                size_t stop = skipQuoted(text, i);
+                paint(colors, i, stop, TC_STRING);
+                i = stop;
+            }
+            else if (c == '#' && text.find_first_not_of(" \t") == i) {
+                size_t stop = i + 1;
+                while (stop < n && isIdentifierByte(text[stop])) stop++;
+                paint(colors, i, stop, TC_KEYWORD);
+                i = stop;
+            }
+            else if (isIdentifierByte(c)) {
+                size_t stop = i + 1;
+                while (stop < n && (isIdentifierByte(text[stop]) || (isdigit(static_cast<unsigned char>(c)) && text[stop] == '.'))) stop++;
+                if (isdigit(static_cast<unsigned char>(c)))
+                    paint(colors, i, stop, TC_NUMBER);
+                else if (colors && isKeyword(text, i, stop))
+                    paint(colors, i, stop, TC_KEYWORD);
+                i = stop;
+            }
+            else {
+                i++;
+            }
+        }
+        return state;
+    }
+};
+
+// ini/conf style files: [sections], key = value, # and ; comments, backslash continuations
+class ConfigHighlighter : public Highlighter {
+private:
+    enum State { NORMAL, CONTINUATION };
+
+public:
+    int highlight(const string& text, int state, vector<unsigned char>* colors) const override {
+        if (colors) colors->assign(text.size(), TC_DEFAULT);
+        bool continues = !text.empty() && text[text.size() - 1] == '\\';
+        if (state == CONTINUATION) {
+            paint(colors, 0, text.size(), TC_STRING);
+            return continues ? CONTINUATION : NORMAL;
+        }
+        size_t start = text.find_first_not_of(" \t");
+        if (start == string::npos) return NORMAL;
+        if (text[start] == '#' || text[start] == ';') {
+            paint(colors, start, text.size(), TC_COMMENT);
+            return NORMAL;
+        }
+        if (text[start] == '[') {
+            size_t close = text.find(']', start);
+            paint(colors, start, close == string::npos ? text.size() : close + 1, TC_SECTION);
+            return NORMAL;
+        }
+        size_t separator = text.find_first_of("=:", start);
+        if (separator == string::npos) return continues ? CONTINUATION : NORMAL;
+        paint(colors, start, separator, TC_KEYWORD);
+        size_t value = text.find_first_not_of(" \t", separator + 1);
+        if (value != string::npos) {
+            if (text[value] == '"' || text[value] == '\'')
+                paint(colors, value, skipQuoted(text, value), TC_STRING);
+            else if (isdigit(static_cast<unsigned char>(text[value])))
+                paint(colors, value, text.size(), TC_NUMBER);
+        }
+        return continues ? CONTINUATION : NORMAL;
+    }
+};
+
+inline const Highlighter* highlighterFor(const string& filename) {
+    static const CLikeHighlighter cLike;
+    static const ConfigHighlighter config;
+    size_t dot = filename.rfind('.');
+    if (dot == string::npos) return nullptr;
+    string ext = filename.substr(dot + 1);
+    for (auto& ch : ext) ch = static_cast<char>(tolower(static_cast<unsigned char>(ch)));
+    if (ext == "c" || ext == "h" || ext == "cpp" || ext == "hpp" || ext == "cc" || ext == "cxx" ||
+        ext == "java" || ext == "js" || ext == "ts" || ext == "cs" || ext == "go" || ext == "rs")
+        return &cLike;
+    if (ext == "ini" || ext == "conf" || ext == "cfg" || ext == "toml" || ext == "properties" ||
+        ext == "env" || ext == "yaml" || ext == "yml")
+        return &config;
+    return nullptr;
+}
+
+// Lexer state at the end of every line. Lines below validLines are known to be correct;
+// an edit only pulls validLines back to the edited line, and re-lexing stops as soon as a
+// line past the last edit ends in the same state it had before.
+class SyntaxCache {
+private:
+    const Highlighter* highlighter;
+    vector<int> endState;
+    size_t validLines;
+    size_t knownLines;
+    size_t lastEdited;
+
+    // lines [first, last] changed; convergence is only trusted from last on
+    void markEdited(size_t first, size_t last) {
+        lastEdited = validLines >= knownLines ? last : max(lastEdited, last);
+        validLines = min(validLines, first);
+    }
+
+public:
+    SyntaxCache() : highlighter(nullptr), validLines(0), knownLines(0), lastEdited(0) {}
+
+    void reset(const Highlighter* newHighlighter, size_t lineCount) {
+        highlighter = newHighlighter;
+        endState.assign(lineCount, 0);
+        validLines = knownLines = lastEdited = 0;
+    }
+
+    bool enabled() const {
+        return highlighter != nullptr;
+    }
+
+    void lineEdited(size_t index) {
+        markEdited(index, index);
+    }
+
+    // inserted lines start out ending where the line above them did, so the last of them
+    // converges exactly when the line below would start in its old state
+    void lineInserted(size_t index, size_t count = 1) {
+        if (count == 0) return;
+        endState.insert(endState.begin() + index, count, index > 0 ? endState[index - 1] : 0);
+        if (knownLines > index) knownLines += count;
+        if (validLines > index) validLines += count;
+        if (lastEdited >= index) lastEdited += count;
+        markEdited(index, index + count - 1);
+    }
+
+    void lineErased(size_t index, size_t count = 1) {
+        if (index >= endState.size()) return;
+        count = min(count, endState.size() - index);
+        endState.erase(endState.begin() + index, endState.begin() + index + count);
+        if (knownLines > index) knownLines -= min(count, knownLines - index);
+        if (validLines > index) validLines -= min(count, validLines - index);
+        if (lastEdited > index) lastEdited = lastEdited >= index + count ? lastEdited - count : index;
+        size_t next = min(index, endState.size());
+        markEdited(next, next);
+    }
+
+    // lexer state at the start of line index, lexing forward from the last valid line as needed
+    int stateBefore(const vector<LinkedList>& lines, size_t index) {
+        while (validLines < index) {
+            size_t line = validLines;
+            int state = highlighter->highlight(lines[line].content(), line > 0 ? endState[line - 1] : 0, nullptr);
+            bool converged = line < knownLines && line >= lastEdited && state == endState[line];
+            endState[line] = state;
+            validLines = converged ? knownLines : line + 1;
+            knownLines = max(knownLines, validLines);
+        }
+        // stopping short leaves the next line lexed from a state that may have changed
+        if (validLines < knownLines) lastEdited = max(lastEdited, validLines);
+        return index > 0 ? endState[index - 1] : 0;
+    }
+
+    void colorize(const vector<LinkedList>& lines, size_t index, vector<unsigned char>& colors) {
+        highlighter->highlight(lines[index].content(), stateBefore(lines, index), &colors);
+    }
+};
+
+// One open file. An inactive buffer keeps its lines parked as they are, so switching back
+// is a swap. Under memory pressure parked lines are frozen into a single contiguous string,
+// which costs a parse on the next switch, and after that the string is dropped (clean
+// buffers re-read the file) or spilled to a temporary file (modified buffers).
+class Buffer {
+private:
+    string frozenText;
+    vector<size_t> lineStarts;
+    bool resident;
+    FILE* spill;
+    // a paged document is always parked, with its block table
+    LinePager pager;
+    vector<LinkedList> parkedLines;
+    bool parked;
+    size_t parkedBytes; // heap held by parked lines that are not paged
+
+    bool readBack() {
+        frozenText.clear();
+        lineStarts.clear();
+        if (spill) {
+            fseek(spill, 0, SEEK_END);
+            long size = ftell(spill);
+            frozenText.resize(size > 0 ? static_cast<size_t>(size) : 0);
+            rewind(spill);
+            size_t got = fread(&frozenText[0], 1, frozenText.size(), spill);
+            frozenText.resize(got);
+            fclose(spill);
+            spill = nullptr;
+        }
+        else {
+            string error;
+            unique_ptr<ByteSource> source = FileManager::openSource(fileName, error);
+            if (!source) return false;
+            vector<char> chunk(1 << 20);
+            while (size_t got = source->read(chunk.data(), chunk.size())) {
+                frozenText.append(chunk.data(), got);
+            }
+            if (source->failed()) return false;
+        }
+        for (size_t pos = 0; pos < frozenText.size();) {
+            lineStarts.push_back(pos);
+            const void* newline = memchr(frozenText.data() + pos, '\n', frozenText.size() - pos);
+            pos = newline ? static_cast<const char*>(newline) - frozenText.data() + 1 : frozenText.size();
+        }
+        resident = true;
+        return true;
+    }
+
+public:
+    string fileName;
+    bool modified;
+    bool readOnly; // a view: nothing on disk to re-read it from
+    int cursorLine;
+    size_t cursorOffset;
+    size_t lastUsed;
+    DiskBaseline baseline; // kept while the buffer is inactive, whatever form its lines take
+    // marks and the jump list, with the anchors that hold their lines
+    LineAnchors anchors;
+    Position marks[26];
+    vector<Position> jumps;
+    size_t jumpIndex;
+
+    Buffer(const string& name) : resident(true), spill(nullptr), parked(false), parkedBytes(0), fileName(name),
+        modified(false), readOnly(false), cursorLine(0), cursorOffset(0), lastUsed(0), jumpIndex(0) {
+        for (Position& mark : marks) mark = { LineAnchors::NONE, 0 };
+    }
+
+    Buffer(const Buffer&) = delete;
+    Buffer& operator=(const Buffer&) = delete;
+
+    Buffer(Buffer&& other) noexcept : Buffer("") {
+        swap(other);
+    }
+
+    Buffer& operator=(Buffer&& other) noexcept {
+        swap(other);
+        return *this;
+    }
+
+    ~Buffer() {
+        clear();
+    }
+
+    void swap(Buffer& other) noexcept {
+        frozenText.swap(other.frozenText);
+        lineStarts.swap(other.lineStarts);
+        std::swap(resident, other.resident);
+        std::swap(spill, other.spill);
+        pager.swap(other.pager);
+        parkedLines.swap(other.parkedLines);
+        std::swap(parked, other.parked);
+        std::swap(parkedBytes, other.parkedBytes);
+        fileName.swap(other.fileName);
+        std::swap(modified, other.modified);
+        std::swap(readOnly, other.readOnly);
+        std::swap(cursorLine, other.cursorLine);
+        std::swap(cursorOffset, other.cursorOffset);
+        std::swap(lastUsed, other.lastUsed);
+        baseline.swap(other.baseline);
+        anchors.swap(other.anchors);
+        for (size_t i = 0; i < 26; ++i) std::swap(marks[i], other.marks[i]);
+        jumps.swap(other.jumps);
+        std::swap(jumpIndex, other.jumpIndex);
+    }
+
+    // drops whatever form the lines are held in
+    void clear() {
+        for (auto& line : parkedLines) line.deleteLine();
+        parkedLines.clear();
+        parked = false;
+        parkedBytes = 0;
+        pager.reset("", false);
+        string().swap(frozenText);
+        vector<size_t>().swap(lineStarts);
+        if (spill) fclose(spill);
+        spill = nullptr;
+        resident = true;
+    }
+
+    bool isResident() const {
+        return resident;
+    }
+
+    size_t frozenBytes() const {
+        return frozenText.size() + lineStarts.size() * sizeof(size_t);
+    }
+
+    // memory the budget charges this buffer for while it is inactive
+    size_t heldBytes() const {
+        return parked ? parkedBytes : frozenBytes();
+    }
+
+    bool isPaged() const {
+        return pager.enabled();
+    }
+
+    bool isParked() const {
+        return parked;
+    }
+
+    // keeps the lines and blocks as they are; a paged document pages out what it can first
+    void park(vector<LinkedList>& lines, LinePager& active) {
+        parkedBytes = 0;
+        if (active.enabled()) {
+            active.pageOutAll(lines);
+        }
+        else {
+            for (const auto& line : lines) parkedBytes += line.size() * LinePager::nodeCost + sizeof(LinkedList);
+        }
+        parkedLines.swap(lines);
+        lines.clear();
+        parked = true;
+        size_t cap = active.cap();
+        pager.swap(active);
+        active.setCap(cap);
+    }
+
+    void unpark(vector<LinkedList>& lines, LinePager& active) {
+        lines.swap(parkedLines);
+        parkedLines.clear();
+        parked = false;
+        parkedBytes = 0;
+        size_t cap = active.cap();
+        active.swap(pager);
+        active.setCap(cap);
+    }
+
+    // trades parked lines for the frozen form; paged documents stay parked
+    void freezeParked() {
+        if (!parked || isPaged()) return;
+        freeze(parkedLines);
+        parked = false;
+        parkedBytes = 0;
+    }
+
+    // moves the lines into the frozen form and frees their nodes
+    void freeze(vector<LinkedList>& lines) {
+        frozenText.clear();
+        lineStarts.clear();
+        lineStarts.reserve(lines.size());
+        for (auto& line : lines) {
+            lineStarts.push_back(frozenText.size());
+            frozenText += line.content();
+            frozenText += '\n';
+            line.deleteLine();
+        }
+        lines.clear();
+        resident = true;
+    }
+
+    bool thaw(vector<LinkedList>& lines) {
+        if (!resident && !readBack()) return false;
+        lines.clear();
+        lines.reserve(lineStarts.size());
+        for (size_t i = 0; i < lineStarts.size(); ++i) {
+            size_t end = i + 1 < lineStarts.size() ? lineStarts[i + 1] : frozenText.size();
+            size_t len = end - lineStarts[i];
+            if (len > 0 && frozenText[end - 1] == '\n') len--;
+            lines.push_back(LinkedList::fromText(frozenText.data() + lineStarts[i], len));
+        }
+        if (lines.empty()) lines.emplace_back();
+        string().swap(frozenText);
+        vector<size_t>().swap(lineStarts);
+        return true;
+    }
+
+    bool evict() {
+        if (!resident) return true;
+        if (modified || readOnly || fileName.empty()) {
+            spill = tmpfile();
+            if (!spill) return false;
+            if (fwrite(frozenText.data(), 1, frozenText.size(), spill) != frozenText.size()) {
+                fclose(spill);
+                spill = nullptr;
+                return false;
+            }
+            fflush(spill);
+        }
+        string().swap(frozenText);
+        vector<size_t>().swap(lineStarts);
+        resident = false;
+        return true;
+    }
+};
+
+class BufferManager {
+private:
+    vector<Buffer> buffers;
+    size_t active;
+    size_t useClock;
+    size_t memoryBudget;
+
+public:
+    BufferManager(size_t budget = 256u * 1024 * 1024) : active(0), useClock(0), memoryBudget(budget) {
+        buffers.emplace_back("");
+    }
+
+    Buffer& current() {
+        return buffers[active];
+    }
+
+    size_t activeIndex() const {
+        return active;
+    }
+
+    size_t count() const {
+        return buffers.size();
+    }
+
+    Buffer& at(size_t index) {
+        return buffers[index];
+    }
+
+    // index of the buffer holding filename, or count() if none does
+    size_t find(const string& filename) const {
+        for (size_t i = 0; i < buffers.size(); ++i) {
+            if (buffers[i].fileName == filename) return i;
+        }
+        return buffers.size();
+    }
+
+    size_t add(const string& filename) {
+        buffers.emplace_back(filename);
+        return buffers.size() - 1;
+    }
+
+    void remove(size_t index) {
+        buffers.erase(buffers.begin() + index);
+        if (active > index) active--;
+    }
+
+    void setActive(size_t index) {
+        active = index;
+        buffers[active].lastUsed = ++useClock;
+    }
+
+    // until the inactive buffers fit the budget, the least recently used one is frozen if
+    // it is parked and evicted if it is frozen
+    void enforceBudget() {
+        size_t used = 0;
+        for (size_t i = 0; i < buffers.size(); ++i) {
+            if (i != active && buffers[i].isResident()) used += buffers[i].heldBytes();
+        }
+        while (used > memoryBudget) {
+            size_t victim = buffers.size();
+            for (size_t i = 0; i < buffers.size(); ++i) {
+                if (i == active || !buffers[i].isResident() || buffers[i].heldBytes() == 0) continue;
+                if (victim == buffers.size() || buffers[i].lastUsed < buffers[victim].lastUsed) victim = i;
+            }
+            if (victim == buffers.size()) break;
+            Buffer& buffer = buffers[victim];
+            used -= buffer.heldBytes();
+            if (buffer.isParked()) {
+                buffer.freezeParked();
+                used += buffer.heldBytes();
+            }
+            else if (!buffer.evict()) {
+                break;
+            }
+        }
+    }
+
+    // name of an inactive buffer holding unsaved changes, or "" if there is none
+    string modifiedInactive() const {
+        for (size_t i = 0; i < buffers.size(); ++i) {
+            if (i != active && buffers[i].modified)
+                return buffers[i].fileName.empty() ? "[No File]" : buffers[i].fileName;
+        }
+        return "";
+    }
+
+    string list() const {
+        string listing;
+        for (size_t i = 0; i < buffers.size(); ++i) {
+            if (!listing.empty()) listing += '\n';
+            listing += to_string(i + 1) + (i == active ? " %a " : "    ") +
+                (buffers[i].modified ? "+ " : "  ") + "\"" +
+                (buffers[i].fileName.empty() ? "[No File]" : buffers[i].fileName) + "\"" +
+                (i != active && !buffers[i].isResident() ? " (on disk)" : "") +
+                (i != active && buffers[i].isPaged() ? " (paged)" : "") +
+                " line " + to_string(buffers[i].cursorLine + 1);
+        }
+        return listing;
+    }
+};
+
+// Watches a growing file and hands back the bytes appended since the last poll.
+// Truncation restarts from the beginning of the file; rotation (a new file under the
+// same path) reopens it, like tail -F.
+class FileFollower {
+private:
+    string path;
+    ifstream file;
+    long long offset;
+    unsigned long long identity;
+    bool following;
+#ifdef __linux__
+    int inotifyFd;
+#endif
+
+    static bool statFile(const string& filename, long long& size, unsigned long long& id) {
+#ifdef _WIN32
+        struct _stat64 info;
+        if (_stat64(filename.c_str(), &info) != 0) return false;
+        id = static_cast<unsigned long long>(info.st_ctime);
+#else
+        struct stat info;
+        if (stat(filename.c_str(), &info) != 0) return false;
+        id = (static_cast<unsigned long long>(info.st_dev) << 32) ^ static_cast<unsigned long long>(info.st_ino);
+#endif
+        size = static_cast<long long>(info.st_size);
+        return true;
+    }
+
+    void watch() {
+#ifdef __linux__
+        if (inotifyFd >= 0) close(inotifyFd);
+        inotifyFd = inotify_init1(IN_NONBLOCK);
+        if (inotifyFd >= 0)
+            inotify_add_watch(inotifyFd, path.c_str(), IN_MODIFY | IN_MOVE_SELF | IN_DELETE_SELF | IN_ATTRIB);
+#endif
+    }
+
+public:
+    enum Event { NONE, APPENDED, TRUNCATED, ROTATED };
+
+    FileFollower() : offset(0), identity(0), following(false)
+#ifdef __linux__
+        , inotifyFd(-1)
+#endif
+    {}
+
+    bool start(const string& filename, long long startOffset) {
+        long long size;
+        if (!statFile(filename, size, identity)) return false;
+        path = filename;
+        file.close();
+        file.clear();
+        file.open(filename, ios::binary);
+        if (!file.is_open()) return false;
+        offset = min(startOffset, size);
+        following = true;
+        watch();
+        return true;
+    }
+
+    void stop() {
+        following = false;
+        file.close();
+#ifdef __linux__
+        if (inotifyFd >= 0) close(inotifyFd);
+        inotifyFd = -1;
+#endif
+    }
+
+    bool isFollowing() const {
+        return following;
+    }
+
+    // descriptor that becomes readable when the file changes, or -1 to rely on polling
+    int notifyHandle() const {
+#ifdef __linux__
+        return inotifyFd;
+#else
+        return -1;
+#endif
+    }
+
+    Event poll(string& appended, size_t maxBytes) {
+        appended.clear();
+        if (!following) return NONE;
+#ifdef __linux__
+        char events[4096];
+        while (inotifyFd >= 0 && read(inotifyFd, events, sizeof(events)) > 0) {}
+#endif
+        Event event = NONE;
+        long long size;
+        unsigned long long id;
+        if (!statFile(path, size, id)) return NONE; // rotated away, new file not created yet
+        if (id != identity) {
+            file.close();
+            file.clear();
+            file.open(path, ios::binary);
+            identity = id;
+            offset = 0;
+            watch();
+            event = ROTATED;
+        }
+        else if (size < offset) {
+            offset = 0;
+            event = TRUNCATED;
+        }
+        if (size > offset) {
+            appended.resize(static_cast<size_t>(min<long long>(size - offset, maxBytes)));
+            file.clear();
+            file.seekg(offset);
+            file.read(&appended[0], appended.size());
+            appended.resize(static_cast<size_t>(file.gcount()));
+            offset += appended.size();
+            if (event == NONE && !appended.empty()) event = APPENDED;
+        }
+        return event;
+    }
+};
+
+// Bounded hand-off between the decoding thread and the line splitter.
+class ChunkQueue {
+private:
+    mutex lock;
+    condition_variable changed;
+    deque<string> chunks;
+    size_t capacity;
+    bool closed;
+
+public:
+    ChunkQueue(size_t maxChunks = 8) : capacity(maxChunks), closed(false) {}
+
+    void reset() {
+        lock_guard<mutex> guard(lock);
+        chunks.clear();
+        closed = false;
+    }
+
+    // waits for room; returns false if the queue was closed meanwhile
+    bool push(string&& chunk) {
+        unique_lock<mutex> guard(lock);
+        changed.wait(guard, [this] { return chunks.size() < capacity || closed; });
+        if (closed) return false;
+        chunks.push_back(move(chunk));
+        changed.notify_all();
+        return true;
+    }
+
+    // waits for a chunk; returns false once the queue is closed and drained
+    bool pop(string& chunk) {
+        unique_lock<mutex> guard(lock);
+        changed.wait(guard, [this] { return !chunks.empty() || closed; });
+        if (chunks.empty()) return false;
+        chunk = move(chunks.front());
+        chunks.pop_front();
+        changed.notify_all();
+        return true;
+    }
+
+    void close() {
+        lock_guard<mutex> guard(lock);
+        closed = true;
+        changed.notify_all();
+    }
+};
+
+// Loads a file in two stages: one thread reads and decompresses into a ChunkQueue, the
+// other splits the chunks into lines and publishes them in batches, so the editor can
+// show the first screen while the rest is still being read.
+class FileLoader {
+private:
+    thread decoder;
+    thread worker;
+    mutable mutex lock;
+    condition_variable published;
+    vector<LinkedList> ready;
+    vector<uint64_t> readyHashes; // LineDiff hash of each ready line's text
+    ChunkQueue chunks;
+    unique_ptr<ByteSource> source;
+    atomic<bool> cancelled;
+    atomic<bool> finished;
+    atomic<bool> decodeFailed;
+    atomic<bool> reachedEnd; // the decoder read the source to its end
+    atomic<bool> complete; // every line of the source was published
+    atomic<long long> bytesRead;
+    long long totalBytes;
+    bool pagedOut; // hand over statistics only; LinePager reads the text back when needed
+    bool endedOpen; // the last line had no newline
+
+    void publish(vector<LinkedList>& batch, vector<uint64_t>& hashes) {
+        {
+            lock_guard<mutex> guard(lock);
+            ready.insert(ready.end(), make_move_iterator(batch.begin()), make_move_iterator(batch.end()));
+            readyHashes.insert(readyHashes.end(), hashes.begin(), hashes.end());
+        }
+        batch.clear();
+        hashes.clear();
+        published.notify_all();
+    }
+
+    void decode() {
+        while (!cancelled) {
+            string chunk(1 << 20, '\0');
+            size_t got = source->read(&chunk[0], chunk.size());
+            bytesRead = source->consumed();
+            if (got == 0) {
+                reachedEnd = true;
+                break;
+            }
+            chunk.resize(got);
+            if (!chunks.push(move(chunk))) break;
+        }
+        decodeFailed = source->failed();
+        chunks.close();
+    }
+
+    LinkedList makeLine(const char* text, size_t len) const {
+        return pagedOut ? LinkedList::pagedOut(text, len) : LinkedList::fromText(text, len);
+    }
+
+    void split() {
+        string chunk;
+        string partial;
+        vector<LinkedList> batch;
+        vector<uint64_t> hashes;
+        bool drained = false;
+        while (!cancelled) {
+            if (!chunks.pop(chunk)) {
+                drained = true;
+                break;
+            }
+            size_t got = chunk.size();
+            size_t pos = 0;
+            while (pos < got) {
+                const void* newline = memchr(chunk.data() + pos, '\n', got - pos);
+                if (!newline) {
+                    partial.append(chunk.data() + pos, got - pos);
+                    break;
+                }
+                size_t end = static_cast<const char*>(newline) - chunk.data();
+                if (partial.empty()) {
+                    batch.push_back(makeLine(chunk.data() + pos, end - pos));
+                    hashes.push_back(LineDiff::hashLine(chunk.data() + pos, end - pos));
+                }
+                else {
+                    partial.append(chunk.data() + pos, end - pos);
+                    batch.push_back(makeLine(partial.data(), partial.size()));
+                    hashes.push_back(LineDiff::hashLine(partial.data(), partial.size()));
+                    partial.clear();
+                }
+                pos = end + 1;
+            }
+            publish(batch, hashes);
+        }
+        bool whole = drained && reachedEnd;
+        if (whole && !partial.empty()) {
+            batch.push_back(makeLine(partial.data(), partial.size()));
+            hashes.push_back(LineDiff::hashLine(partial.data(), partial.size()));
+            endedOpen = true;
+            publish(batch, hashes);
+        }
+        complete = whole;
+        finished = true;
+        published.notify_all();
+    }
+
+public:
+    FileLoader() : cancelled(false), finished(true), decodeFailed(false), reachedEnd(false), complete(false),
+        bytesRead(0), totalBytes(0), pagedOut(false), endedOpen(false) {}
+
+    // a load still running when the editor quits is stopped rather than left to terminate()
+    ~FileLoader() {
+        cancel();
+        if (worker.joinable()) worker.join();
+        if (decoder.joinable()) decoder.join();
+    }
+
+    void start(unique_ptr<ByteSource> input, long long inputBytes, bool paged = false) {
+        source = move(input);
+        totalBytes = inputBytes;
+        pagedOut = paged;
+        endedOpen = false;
+        cancelled = false;
+        finished = false;
+        decodeFailed = false;
+        reachedEnd = false;
+        complete = false;
+        bytesRead = 0;
+        chunks.reset();
+        decoder = thread(&FileLoader::decode, this);
+        worker = thread(&FileLoader::split, this);
+    }
+
+    bool isLoading() const {
+        return worker.joinable();
+    }
+
+    // blocks until a first batch is available or the whole file has been read
+    void waitForLines() {
+        unique_lock<mutex> guard(lock);
+        published.wait(guard, [this] { return !ready.empty() || finished; });
+    }
+
+    // appends the lines parsed so far to out and their hashes to hashes; returns false once
+    // the load is complete
+    bool take(vector<LinkedList>& out, vector<uint64_t>& hashes) {
+        bool done = finished;
+        {
+            lock_guard<mutex> guard(lock);
+            out.insert(out.end(), make_move_iterator(ready.begin()), make_move_iterator(ready.end()));
+            hashes.insert(hashes.end(), readyHashes.begin(), readyHashes.end());
+            ready.clear();
+            readyHashes.clear();
+        }
+        if (done && worker.joinable()) {
+            worker.join();
+            decoder.join();
+            source.reset();
+            return false;
+        }
+        return worker.joinable();
+    }
+
+    void cancel() {
+        cancelled = true;
+        chunks.close();
+    }
+
+    int percentDone() const {
+        return totalBytes > 0 ? static_cast<int>(bytesRead * 100 / totalBytes) : 100;
+    }
+
+    // a cancel that came after the last line was read did not cut anything short
+    bool wasCancelled() const {
+        return cancelled && !complete;
+    }
+
+    bool hasFailed() const {
+        return decodeFailed;
+    }
+
+    bool lastLineOpen() const {
+        return endedOpen;
+    }
+};
+
+// Sorts items with one thread per hardware core: each sorts a slice, then slices are
+// merged pairwise, the merges of each round also running in parallel.
+template <typename T, typename Compare>
+void parallelSort(vector<T>& items, Compare less) {
+    size_t workers = max(1u, thread::hardware_concurrency());
+    workers = min(workers, items.size() / 32768 + 1);
+    if (workers < 2) {
+        sort(items.begin(), items.end(), less);
+        return;
+    }
+    vector<size_t> bounds;
+    for (size_t k = 0; k <= workers; ++k) {
+        bounds.push_back(items.size() * k / workers);
+    }
+    vector<thread> pool;
+    for (size_t k = 0; k < workers; ++k) {
+        pool.emplace_back([&, k] { sort(items.begin() + bounds[k], items.begin() + bounds[k + 1], less); });
+    }
+    for (auto& worker : pool) worker.join();
+    for (size_t width = 1; width < workers; width *= 2) {
+        pool.clear();
+        for (size_t k = 0; k + width < workers; k += 2 * width) {
+            size_t end = min(k + 2 * width, workers);
+            pool.emplace_back([&, k, width, end] {
+                inplace_merge(items.begin() + bounds[k], items.begin() + bounds[k + width], items.begin() + bounds[end], less);
+            });
+        }
+        for (auto& worker : pool) worker.join();
+    }
+}
+
+// creates an empty temporary file and returns its path, or "" on failure
+inline string temporaryPath() {
+#ifdef _WIN32
+    char directory[MAX_PATH];
+    char path[MAX_PATH];
+    if (!GetTempPathA(MAX_PATH, directory) || !GetTempFileNameA(directory, "ted", 0, path)) return "";
+    return path;
+#else
+    const char* directory = getenv("TMPDIR");
+    string path = string(directory && *directory ? directory : "/tmp") + "/texteditor-XXXXXX";
+    int fd = mkstemp(&path[0]);
+    if (fd < 0) return "";
+    close(fd);
+    return path;
+#endif
+}
+
+inline size_t terminalColumns() {
+#ifdef _WIN32
+    CONSOLE_SCREEN_BUFFER_INFO info;
+    if (GetConsoleScreenBufferInfo(GetStdHandle(STD_OUTPUT_HANDLE), &info))
+        return info.srWindow.Right - info.srWindow.Left + 1;
+#else
+    struct winsize size;
+    if (ioctl(STDOUT_FILENO, TIOCGWINSZ, &size) == 0 && size.ws_col > 0)
+        return size.ws_col;
+#endif
+    return 80;
+}
+
+inline size_t terminalRows() {
+#ifdef _WIN32
+    CONSOLE_SCREEN_BUFFER_INFO info;
+    if (GetConsoleScreenBufferInfo(GetStdHandle(STD_OUTPUT_HANDLE), &info))
+        return info.srWindow.Bottom - info.srWindow.Top + 1;
+#else
+    struct winsize size;
+    if (ioctl(STDOUT_FILENO, TIOCGWINSZ, &size) == 0 && size.ws_row > 0)
+        return size.ws_row;
+#endif
+    return 24;
+}
+
+// yanked text; LINES pastes as whole lines, CHARS inline at the cursor, BLOCK as a column
+struct Register {
+    enum Kind { LINES, CHARS, BLOCK };
+    Kind kind;
+    vector<string> text;
+
+    Register() : kind(LINES) {}
+};
+
+struct EditorStatus {
+    enum Mode { INSERT, NORMAL, VISUAL, VISUAL_LINE, VISUAL_BLOCK };
+    Mode currentMode;
+    size_t cursorLine;
+    size_t cursorColumn;
+    size_t totalLines;
+    string lastCommand;
+    string message;
+};
+
+
+class TextEditor {
+private:
+    vector<LinkedList> lines;
+    int currentLine;
+    LinkedList::Iterator charCursor;
+    bool insertMode;
+    Register copyRegister;
+    EditorStatus status;
+    FileManager fileManager;
+    SearchEngine searchEngine;
+    LineStatsTree lineStats;
+    BufferManager buffers;
+    mutable SyntaxCache syntax;
+    size_t topLine;
+    FileFollower follower;
+    bool lastLineOpen; // followed file has not terminated the last line yet
+    FileLoader loader;
+    bool incompleteLoad; // a cancelled load left the buffer shorter than its file
+    int anchorLine; // visual selection runs from the anchor to the cursor
+    size_t anchorColumn;
+    LinePager pager; // holds the blocks of documents too large to keep as nodes
+    LineAnchors anchors;
+    DiskBaseline baseline; // which lines differ from the file on disk
+    Position marks[26];
+    vector<Position> jumps; // older positions first; jumpIndex is where Ctrl-O/Ctrl-I stand
+    size_t jumpIndex;
+
+    // an edit that puts back what the file holds leaves the buffer unmodified
+    void updateModifiedStatus() 
+    {
+        // a read-only view has no file to differ from
+        if (fileManager.isReadOnly() || baseline.matchesDisk())
+            fileManager.clearModified();
+        else
+            fileManager.markAsModified();
+    }
+
+    // keep per-line derived state in step with edits to lines
+    void lineEdited(size_t index) {
+        baseline.lineEdited(lines, index);
+        lineStats.update(index, lines[index].getStats());
+        syntax.lineEdited(index);
+        pager.lineEdited(lines, index);
+    }
+    void lineInserted(size_t index, size_t count = 1) {
+        baseline.lineInserted(lines, index, count);
+        lineStats.insert(index, lines, count);
+        syntax.lineInserted(index, count);
+        pager.lineInserted(lines, index, count);
+        anchors.insert(index, count);
+    }
+    void lineErased(size_t index, size_t count = 1) {
+        baseline.lineErased(index, count);
+        lineStats.erase(index, count);
+        syntax.lineErased(index, count);
+        pager.lineErased(lines, index, count);
+        anchors.erase(index, count);
+    }
+    // lines the loader appended from first on; the pager files them by their place in the file
+    void linesLoaded(size_t first, const vector<uint64_t>& hashes) {
+        if (first == lines.size()) return;
+        baseline.loaded(lines, first, hashes);
+        lineStats.insert(first, lines, lines.size() - first);
+        syntax.lineInserted(first, lines.size() - first);
+        anchors.insert(first, lines.size() - first);
+        pager.append(lines, first);
+    }
+    // paged documents are not highlighted: lexing up to the viewport would page in everything before it
+    void linesReloaded() {
+        lineStats.reset(lines);
+        bool highlight = fileManager.hasFileName() && !pager.enabled();
+        syntax.reset(highlight ? highlighterFor(fileManager.getCurrentFileName()) : nullptr, lines.size());
+        topLine = 0;
+    }
+
+    // a new document starts without marks or jumps
+    void resetBookmarks() {
+        anchors.reset(lines.size());
+        for (Position& mark : marks) mark = { LineAnchors::NONE, 0 };
+        jumps.clear();
+        jumpIndex = 0;
+    }
+
+    // marks and jumps travel with their buffer
+    void swapBookmarks(Buffer& buffer) {
+        anchors.swap(buffer.anchors);
+        for (size_t i = 0; i < 26; ++i) std::swap(marks[i], buffer.marks[i]);
+        jumps.swap(buffer.jumps);
+        std::swap(jumpIndex, buffer.jumpIndex);
+    }
+
+    // makes lines [first, last] of a paged document resident before they are used
+    bool pageIn(size_t first, size_t last) {
+        if (!pager.enabled() || pager.pageIn(lines, first, last, currentLine)) return true;
+        status.message = "Cannot read back part of the file -- it changed on disk, so those lines cannot be edited or saved";
+        return false;
+    }
+
+    // rows left for text after the two rules, the status line and the message line
+    size_t textRows() const {
+        size_t rows = terminalRows();
+        return rows > 5 ? rows - 4 : 1;
+    }
+
+    bool isWordCharacter(char c) const
+    {
+        return charClassOf(c) == CC_WORD;
+    }
+
+    bool isPunctuation(char c) const
+    {
+        return charClassOf(c) == CC_PUNCT;
+    }
+
+    // caret position in bytes: 0 before the first character, n after the nth
+    size_t cursorOffset() const {
+        if (charCursor == nullptr) return 0;
+        return lines[currentLine].indexOf(charCursor) + 1;
+    }
+
+    void setCursorOffset(size_t offset) {
+        charCursor = offset == 0 ? LinkedList::Iterator(nullptr) : lines[currentLine].at(offset - 1);
+    }
+
+public:
+    TextEditor() : currentLine(0), insertMode(true), charCursor(nullptr), topLine(0), lastLineOpen(false), incompleteLoad(false),
+        anchorLine(0), anchorColumn(0), jumpIndex(0) 
+    {
+        lines.emplace_back();
+        charCursor = lines[0].begin();
+        status = { EditorStatus::INSERT, 0, 0, 1, "", "" };
+        baseline.detach(lines);
+        pager.verifyAgainst(&baseline.lineHashes());
+        linesReloaded();
+        resetBookmarks();
+    }
+
+    // whether filename still holds what the buffer was last loaded from or saved to
+    bool diskUnchanged(const string& filename) const {
+        vector<uint64_t> onDisk;
+        return hashFileLines(filename, onDisk, nullptr) && baseline.describes(onDisk);
+    }
+
+    // writes only the dirty lines back when none changed length and nothing else changed the
+    // file since, otherwise the whole file
+    bool saveDocument(const string& filename) {
+        if (fileManager.isReadOnly() && filename == fileManager.getCurrentFileName()) {
+            status.message = filename + " is a read-only view -- :w <name> saves a copy";
+            return false;
+        }
+        vector<FileManager::Patch> patches;
+        bool inPlace = false;
+        if (filename == fileManager.getCurrentFileName() && !fileManager.isCompressed() &&
+            baseline.patches(lines, patches) && diskUnchanged(filename)) {
+            inPlace = fileManager.patchFile(filename, baseline.fileBytes(), lines, patches, &pager);
+        }
+        if (inPlace && pager.enabled()) pager.savedTo(filename);
+        if (!inPlace && !fileManager.saveFile(filename, lines, &pager)) {
+            status.message = "Cannot write " + filename;
+            return false;
+        }
+        baseline.saved(lines);
+        return true;
+    }
+
+    // Search commands
+    bool search(const string& pattern) 
+    {
+        int cursorPos = static_cast<int>(cursorOffset());
+        Position from = here();
+        bool found = searchEngine.search(pattern, lines, currentLine, charCursor, cursorPos, &pager);
+        finishJump(from, found);
+        return found;
+    }
+    bool findNext() 
+    {
+        int cursorPos = static_cast<int>(cursorOffset());
+        Position from = here();
+        bool found = searchEngine.findNext(lines, currentLine, charCursor, cursorPos, &pager);
+        finishJump(from, found);
+        return found;
+    }
+    bool findPrevious() 
+    {
+        int cursorPos = static_cast<int>(cursorOffset());
+        return searchEngine.findPrevious(lines, currentLine, charCursor, cursorPos);
+    }
+
+    // Replace commands
+    void replace(const string& old, const string& newStr, bool global = false) {
+        // the line is rebuilt, so the cursor's node goes with it
+        size_t offset = cursorOffset();
+        searchEngine.replace(old, newStr, lines[currentLine], global);
+        setCursorOffset(min(offset, lines[currentLine].size()));
+        lineEdited(currentLine);
+        updateModifiedStatus();
+    }
+
+    // Advanced commands
+    void joinLines() {
+        if (currentLine < lines.size() - 1) {
+            joinRange(currentLine, currentLine + 1);
+        }
+    }
+
+    // splices lines (first, last] onto line first, each in O(1)
+    void joinRange(size_t first, size_t last) {
+        for (size_t line = first + 1; line <= last; ++line) {
+            lines[first].splice(lines[line]);
+        }
+        lines.erase(lines.begin() + first + 1, lines.begin() + last + 1);
+        lineErased(first + 1, last - first);
+        lineEdited(first);
+        if (currentLine > static_cast<int>(first)) {
+            currentLine = first;
+            charCursor = lines[first].begin();
+        }
+        updateModifiedStatus();
+    }
+
+    void indentRange(size_t first, size_t last, int levels) {
+        for (size_t line = first; line <= last; ++line) {
+            for (int level = 0; level < levels; ++level) {
+                lines[line].insertText(0, "\t", 1);
+            }
+            for (int level = 0; level > levels && !lines[line].isEmpty() && lines[line].content()[0] == '\t'; --level) {
+                if (line == static_cast<size_t>(currentLine) && charCursor == lines[line].begin()) charCursor = nullptr;
+                lines[line].eraseRange(0, 1);
+            }
+            lineEdited(line);
+        }
+        updateModifiedStatus();
+    }
+
+    // reorders the LinkedList objects themselves, so no node is copied
+    void sortRange(size_t first, size_t last, bool reverse, bool unique) {
+        size_t count = last - first + 1;
+        vector<const string*> keys(count);
+        for (size_t i = 0; i < count; ++i) {
+            keys[i] = &lines[first + i].content();
+        }
+        vector<unsigned int> order(count);
+        for (size_t i = 0; i < count; ++i) {
+            order[i] = static_cast<unsigned int>(i);
+        }
+        // ties keep their original order so the result does not depend on the thread count
+        parallelSort(order, [&keys, reverse](unsigned int a, unsigned int b) {
+            int compared = keys[a]->compare(*keys[b]);
+            if (compared == 0) return a < b;
+            return reverse ? compared > 0 : compared < 0;
+        });
+        vector<LinkedList> sorted;
+        sorted.reserve(count);
+        for (size_t i = 0; i < count; ++i) {
+            if (unique && !sorted.empty() && *keys[order[i]] == sorted.back().content()) {
+                lines[first + order[i]].deleteLine();
+                continue;
+            }
+            sorted.push_back(move(lines[first + order[i]]));
+        }
+        replaceLines(first, count, sorted);
+    }
+
+    // pipes lines [first, last] through a shell command and replaces them with its output
+    bool filterRange(size_t first, size_t last, const string& command) {
+        string input = temporaryPath();
+        if (input.empty()) {
+            status.message = "Cannot create a temporary file";
+            return false;
+        }
+        {
+            ofstream file(input, ios::binary);
+            for (size_t line = first; line <= last; ++line) {
+                file << lines[line].content() << '\n';
+            }
+        }
+        string shellCommand = command + " < \"" + input + "\"";
+#ifdef _WIN32
+        FILE* pipe = _popen(shellCommand.c_str(), "rb");
+#else
+        FILE* pipe = popen(shellCommand.c_str(), "r");
+#endif
+        if (!pipe) {
+            remove(input.c_str());
+            status.message = "Cannot run " + command;
+            return false;
+        }
+        vector<LinkedList> output;
+        string partial;
+        vector<char> chunk(1 << 16);
+        while (size_t got = fread(chunk.data(), 1, chunk.size(), pipe)) {
+            partial.append(chunk.data(), got);
+            size_t start = 0;
+            while (const void* newline = memchr(partial.data() + start, '\n', partial.size() - start)) {
+                size_t end = static_cast<const char*>(newline) - partial.data();
+                output.push_back(LinkedList::fromText(partial.data() + start, end - start));
+                start = end + 1;
+            }
+            partial.erase(0, start);
+        }
+        if (!partial.empty()) output.push_back(LinkedList::fromText(partial.data(), partial.size()));
+#ifdef _WIN32
+        int result = _pclose(pipe);
+#else
+        int result = pclose(pipe);
+#endif
+        remove(input.c_str());
+        if (result != 0) {
+            for (auto& line : output) line.deleteLine();
+            status.message = "Filter failed -- lines left unchanged";
+            return false;
+        }
+        for (size_t line = first; line <= last; ++line) {
+            lines[line].deleteLine();
+        }
+        replaceLines(first, last - first + 1, output);
+        return true;
+    }
+
+    // puts replacement in place of lines [first, first + count) whose nodes are already released
+    void replaceLines(size_t first, size_t count, vector<LinkedList>& replacement) {
+        lines.erase(lines.begin() + first, lines.begin() + first + count);
+        lines.insert(lines.begin() + first, make_move_iterator(replacement.begin()), make_move_iterator(replacement.end()));
+        lineErased(first, count);
+        lineInserted(first, replacement.size());
+        if (lines.empty()) {
+            lines.emplace_back();
+            lineInserted(0);
+        }
+        if (currentLine >= static_cast<int>(lines.size())) currentLine = lines.size() - 1;
+        if (currentLine >= static_cast<int>(first)) charCursor = lines[currentLine].begin();
+        updateModifiedStatus();
+    }
+
+    // reads "N", ".", "$", each with optional +N/-N, as a zero-based line
+    bool parseAddress(const string& cmd, size_t& pos, size_t& line) const {
+        long long value;
+        if (pos < cmd.size() && cmd[pos] == '.') {
+            value = currentLine;
+            pos++;
+        }
+        else if (pos < cmd.size() && cmd[pos] == '$') {
+            value = static_cast<long long>(lines.size()) - 1;
+            pos++;
+        }
+        else if (pos < cmd.size() && isdigit(static_cast<unsigned char>(cmd[pos]))) {
+            value = 0;
+            while (pos < cmd.size() && isdigit(static_cast<unsigned char>(cmd[pos]))) {
+                value = value * 10 + (cmd[pos++] - '0');
+            }
+            value--;
+        }
+        else {
+            return false;
+        }
+        while (pos < cmd.size() && (cmd[pos] == '+' || cmd[pos] == '-')) {
+            int sign = cmd[pos++] == '+' ? 1 : -1;
+            long long offset = 0;
+            bool digits = false;
+            while (pos < cmd.size() && isdigit(static_cast<unsigned char>(cmd[pos]))) {
+                offset = offset * 10 + (cmd[pos++] - '0');
+                digits = true;
+            }
+            value += sign * (digits ? offset : 1);
+        }
+        line = static_cast<size_t>(max(0LL, min(value, static_cast<long long>(lines.size()) - 1)));
+        return true;
+    }
+
+    // "%", "a" or "a,b"; false leaves pos untouched when cmd has no range
+    bool parseRange(const string& cmd, size_t& pos, size_t& first, size_t& last) const {
+        if (pos < cmd.size() && cmd[pos] == '%') {
+            pos++;
+            first = 0;
+            last = lines.size() - 1;
+            return true;
+        }
+        size_t start = pos;
+        if (!parseAddress(cmd, pos, first)) return false;
+        last = first;
+        if (pos < cmd.size() && cmd[pos] == ',' && !parseAddress(cmd, ++pos, last)) {
+            pos = start;
+            return false;
+        }
+        if (first > last) swap(first, last);
+        return true;
+    }
+
+    // :[range]> :[range]< :[range]J :[range]sort[!] [u] :{range}!cmd
+    bool rangeCommand(const string& cmd) {
+        size_t pos = 0;
+        size_t first = currentLine, last = currentLine;
+        bool hasRange = parseRange(cmd, pos, first, last);
+        string rest = cmd.substr(pos);
+        if (rest.rfind("sort", 0) == 0 && !hasRange) {
+            first = 0;
+            last = lines.size() - 1;
+        }
+        if (hasRange && rest.empty()) {
+            jumpToLine(last);
+            return true;
+        }
+        // lines are paged in only once the command is known, and only those it changes
+        if (!rest.empty() && (rest[0] == '>' || rest[0] == '<')) {
+            size_t levels = rest.find_first_not_of(rest[0]);
+            if (levels == string::npos) levels = rest.size();
+            else if (rest.find_first_not_of(' ', levels) != string::npos) return false;
+            if (pageIn(first, last))
+                indentRange(first, last, rest[0] == '>' ? static_cast<int>(levels) : -static_cast<int>(levels));
+            return true;
+        }
+        if (rest == "J") {
+            if (first == last) last = min(first + 1, lines.size() - 1);
+            if (first < last && pageIn(first, last)) joinRange(first, last);
+            return true;
+        }
+        if (rest.rfind("sort", 0) == 0) {
+            bool reverse = rest.size() > 4 && rest[4] == '!';
+            bool unique = rest.find(" u", 4) != string::npos;
+            if (pageIn(first, last)) sortRange(first, last, reverse, unique);
+            return true;
+        }
+        if (hasRange && !rest.empty() && rest[0] == '!' && rest.size() > 1) {
+            return pageIn(first, last) && filterRange(first, last, rest.substr(1));
+        }
+        return false;
+    }
+
+    void indentLine(bool increase) {
+        indentRange(currentLine, currentLine, increase ? 1 : -1);
+    }
+
+    void deleteLineNumber(size_t lineNum) {
+        lineNum--;
+        if (lineNum < lines.size()) {
+            pageIn(lineNum, lineNum);
+            lines.erase(lines.begin() + lineNum);
+            lineErased(lineNum);
+            if (currentLine >= lines.size()) {
+                currentLine = lines.size() - 1;
+            }
+            charCursor = lines[currentLine].begin();
+        }
+    }
+
+    // file commands
+    bool handleFileCommand(const string& cmd) {
+        
+        if (rangeCommand(cmd)) {
+            return true;
+        }
+        else if (cmd.rfind("w ", 0) == 0 || cmd.rfind("w! ", 0) == 0) { 
+            bool force = cmd[1] == '!';
+            string filename = cmd.substr(force ? 3 : 2);
+            finishLoad();
+            if (incompleteLoad && !force && filename == fileManager.getCurrentFileName()) {
+                status.message = "Buffer holds a partial load -- use :w! to overwrite the file";
+                return false;
+            }
+            if (saveDocument(filename)) {
+                buffers.current().fileName = filename;
+                cout << "file : " << filename << " saved";
+                return true;
+            }
+
+        }
+        else if (cmd == "q") {
+            // recheck only a buffer already marked modified; one never edited stays clean without a baseline
+            if (fileManager.hasUnsavedChanges()) updateModifiedStatus();
+            if (fileManager.hasUnsavedChanges()) {
+                cout << "Warning: Unsaved changes -- Use :q! to force quit\n";
+                Sleep(1000);
+            }
+            else if (!buffers.modifiedInactive().empty()) {
+                cout << "Warning: Unsaved changes in " << buffers.modifiedInactive() << " -- Use :q! to force quit\n";
+                Sleep(1000);
+            }
+            else {
+                exit(0);
+            }
+        }
+        else if (cmd == "q!") { 
+            exit(0);
+        }
+        else if (cmd == "wq") { 
+            finishLoad();
+            if (incompleteLoad) {
+                status.message = "Buffer holds a partial load -- use :w! to overwrite the file";
+                return false;
+            }
+            if (!fileManager.getCurrentFileName().empty() &&
+                saveDocument(fileManager.getCurrentFileName())) {
+                if (buffers.modifiedInactive().empty()) exit(0);
+                status.message = "Unsaved changes in " + buffers.modifiedInactive() + " -- use :q! to quit anyway";
+                return true;
+            }
+
+        }
+        else if (cmd == "wc") {
+            wordCount();
+            return true;
+        }
+        else if (cmd.rfind("e ", 0) == 0) { 
+            return openBuffer(cmd.substr(2));
+        }
+        else if (cmd == "bn" || cmd == "bnext") {
+            return switchToBuffer((buffers.activeIndex() + 1) % buffers.count());
+        }
+        else if (cmd == "bp" || cmd == "bprevious") {
+            return switchToBuffer((buffers.activeIndex() + buffers.count() - 1) % buffers.count());
+        }
+        else if (cmd == "ls" || cmd == "buffers") {
+            status.message = buffers.list();
+            return true;
+        }
+        else if (cmd == "follow") {
+            finishLoad();
+            return startFollow();
+        }
+        else if (cmd == "diff" || cmd == "diff side") {
+            finishLoad();
+            return diffWithDisk(cmd == "diff side");
+        }
+        else if (cmd == "pagecap" || cmd.rfind("pagecap ", 0) == 0) {
+            if (cmd.size() > 8) {
+                long long megabytes = atoll(cmd.c_str() + 8);
+                if (megabytes <= 0) {
+                    status.message = "Usage: :pagecap <MB>";
+                    return false;
+                }
+                pager.setCap(static_cast<size_t>(megabytes) << 20);
+                pageIn(currentLine, currentLine);
+            }
+            status.message = pager.enabled() ? pager.describe() : "Paging is off for this buffer, cap " +
+                to_string(pager.cap() >> 20) + " MB";
+            return true;
+        }
+        return false;
+    }
+
+    // jumps and marks
+    Position here() {
+        return { anchors.add(currentLine), cursorOffset() };
+    }
+
+    // only the target line is paged in, so a jump costs the same at any distance
+    void goTo(size_t line, size_t offset) {
+        currentLine = static_cast<int>(min(line, lines.size() - 1));
+        pageIn(currentLine, currentLine);
+        setCursorOffset(min(offset, lines[currentLine].size()));
+    }
+
+    // keeps from in the jump list if the jump happened; positions ahead of it are dropped
+    void finishJump(const Position& from, bool jumped) {
+        if (!jumped) {
+            anchors.release(from.anchor);
+            return;
+        }
+        for (size_t i = jumpIndex; i < jumps.size(); ++i) anchors.release(jumps[i].anchor);
+        jumps.resize(min(jumpIndex, jumps.size()));
+        jumps.push_back(from);
+        if (jumps.size() > 100) {
+            anchors.release(jumps.front().anchor);
+            jumps.erase(jumps.begin());
+        }
+        jumpIndex = jumps.size();
+    }
+
+    void jumpToLine(size_t line) {
+        finishJump(here(), true);
+        goTo(line, 0);
+    }
+
+    // line N% of the way into the file, rounded up as vim does
+    void jumpToPercent(size_t percent) {
+        size_t line = (min<size_t>(percent, 100) * lines.size() + 99) / 100;
+        jumpToLine(line > 0 ? line - 1 : 0);
+    }
+
+    void setMark(char name) {
+        Position& mark = marks[name - 'a'];
+        anchors.release(mark.anchor);
+        mark = here();
+    }
+
+    // exact goes back to the marked column, otherwise to the start of the line
+    bool jumpToMark(char name, bool exact) {
+        size_t line;
+        if (!anchors.lineOf(marks[name - 'a'].anchor, line)) {
+            status.message = "Mark not set";
+            return false;
+        }
+        finishJump(here(), true);
+        goTo(line, exact ? marks[name - 'a'].offset : 0);
+        return true;
+    }
+
+    // Ctrl-O: the first step back remembers where it started so Ctrl-I can return there
+    void jumpOlder() {
+        if (jumps.empty() || jumpIndex == 0) return;
+        if (jumpIndex == jumps.size()) {
+            jumps.push_back(here());
+            jumpIndex = jumps.size() - 1;
+        }
+        size_t line;
+        while (jumpIndex > 0) {
+            if (anchors.lineOf(jumps[--jumpIndex].anchor, line)) {
+                goTo(line, jumps[jumpIndex].offset);
+                return;
+            }
+        }
+    }
+
+    void jumpNewer() {
+        size_t line;
+        while (jumpIndex + 1 < jumps.size()) {
+            if (anchors.lineOf(jumps[++jumpIndex].anchor, line)) {
+                goTo(line, jumps[jumpIndex].offset);
+                return;
+            }
+        }
+    }
+
+    // diff against the file on disk
+    // hashes every line of filename; starts, when given, receives the byte offset of each line
+    static bool hashFileLines(const string& filename, vector<uint64_t>& hashes, vector<long long>* starts) {
+        string error;
+        unique_ptr<ByteSource> source = FileManager::openSource(filename, error);
+        if (!source) return false;
+        vector<char> chunk(1 << 20);
+        uint64_t hash = LineDiff::hashBasis;
+        bool open = false;
+        long long chunkStart = 0, lineStart = 0;
+        while (size_t got = source->read(chunk.data(), chunk.size())) {
+            for (size_t pos = 0; pos < got;) {
+                const void* newline = memchr(chunk.data() + pos, '\n', got - pos);
+                size_t end = newline ? static_cast<const char*>(newline) - chunk.data() : got;
+                hash = LineDiff::hashMore(hash, chunk.data() + pos, end - pos);
+                open = true;
+                if (!newline) break;
+                hashes.push_back(hash);
+                if (starts) starts->push_back(lineStart);
+                hash = LineDiff::hashBasis;
+                open = false;
+                lineStart = chunkStart + static_cast<long long>(end) + 1;
+                pos = end + 1;
+            }
+            chunkStart += static_cast<long long>(got);
+        }
+        if (open) {
+            hashes.push_back(hash);
+            if (starts) starts->push_back(lineStart);
+        }
+        return !source->failed();
+    }
+
+    // text of the lines of filename listed in wanted, which must be sorted
+    static bool readFileLines(const string& filename, const vector<size_t>& wanted, vector<string>& text) {
+        string error;
+        unique_ptr<ByteSource> source = FileManager::openSource(filename, error);
+        if (!source) return false;
+        vector<char> chunk(1 << 20);
+        string line;
+        size_t index = 0, next = 0;
+        while (next < wanted.size()) {
+            size_t got = source->read(chunk.data(), chunk.size());
+            if (got == 0) break;
+            for (size_t pos = 0; pos < got && next < wanted.size();) {
+                const void* newline = memchr(chunk.data() + pos, '\n', got - pos);
+                size_t end = newline ? static_cast<const char*>(newline) - chunk.data() : got;
+                if (index == wanted[next]) line.append(chunk.data() + pos, end - pos);
+                if (!newline) break;
+                if (index == wanted[next]) {
+                    text.push_back(move(line));
+                    line.clear();
+                    next++;
+                }
+                index++;
+                pos = end + 1;
+            }
+        }
+        if (next < wanted.size() && index == wanted[next] && !line.empty()) text.push_back(move(line));
+        text.resize(wanted.size());
+        return !source->failed();
+    }
+
+    // pads or cuts text to exactly width columns, expanding tabs and cutting between code points
+    static string fitColumns(const string& text, size_t width) {
+        string fitted;
+        size_t columns = 0;
+        for (size_t i = 0; i < text.size() && columns < width;) {
+            if (text[i] == '\t') {
+                size_t stop = min(width, (columns / 8 + 1) * 8);
+                fitted.append(stop - columns, ' ');
+                columns = stop;
+                i++;
+                continue;
+            }
+            size_t len = utf8SequenceLength(text.data(), i, text.size());
+            fitted.append(text, i, len);
+            columns++;
+            i += len;
+        }
+        fitted.append(width - columns, ' ');
+        return fitted;
+    }
+
+    // lines that sit in blocks the pager never changed are hashed from the file on disk
+    // in the same pass as the old side, so a mostly untouched paged document is only read once
+    bool diffWithDisk(bool sideBySide) {
+        if (!fileManager.hasFileName()) {
+            status.message = "No file to compare with";
+            return false;
+        }
+        string filename = fileManager.getCurrentFileName();
+        bool reuse = pager.enabled() && pager.readsFrom(filename);
+        vector<uint64_t> diskHashes;
+        vector<long long> diskStarts;
+        if (!hashFileLines(filename, diskHashes, reuse ? &diskStarts : nullptr)) {
+            status.message = "Cannot read " + filename;
+            return false;
+        }
+
+        // clean blocks hold what the file held at load time, so they may share its hashes
+        // only while the file still holds exactly that
+        reuse = reuse && baseline.describes(diskHashes);
+        vector<uint64_t> bufferHashes(lines.size());
+        vector<bool> hashed(lines.size(), false);
+        if (reuse) {
+            for (const LinePager::CleanRun& run : pager.cleanRuns()) {
+                auto start = lower_bound(diskStarts.begin(), diskStarts.end(), run.offset);
+                size_t first = start - diskStarts.begin();
+                if (start == diskStarts.end() || *start != run.offset || first + run.lineCount > diskHashes.size()) continue;
+                for (size_t i = 0; i < run.lineCount; ++i) {
+                    bufferHashes[run.firstLine + i] = diskHashes[first + i];
+                    hashed[run.firstLine + i] = true;
+                }
+            }
+        }
+        // a paged-out line keeps the hash of its text; paging it in from a changed file would fail
+        const vector<uint64_t>& kept = baseline.lineHashes();
+        for (size_t i = 0; i < lines.size(); ++i) {
+            if (hashed[i]) continue;
+            if (lines[i].isPagedOut() && kept.size() == lines.size()) {
+                bufferHashes[i] = kept[i];
+                continue;
+            }
+            if (!pageIn(i, i)) return false;
+            const string& text = lines[i].content();
+            bufferHashes[i] = LineDiff::hashLine(text.data(), text.size());
+        }
+        // an empty buffer still holds one empty line, an empty file has none
+        if (lines.size() == 1 && lines[0].isEmpty() && diskHashes.empty()) bufferHashes.clear();
+
+        LineDiff diff(diskHashes, bufferHashes);
+        const vector<LineDiff::Run>& runs = diff.runs();
+        size_t removed = 0, added = 0;
+        for (const LineDiff::Run& run : runs) {
+            if (run.kind == LineDiff::REMOVED) removed += run.count;
+            if (run.kind == LineDiff::ADDED) added += run.count;
+        }
+        if (removed == 0 && added == 0) {
+            status.message = "No differences";
+            return true;
+        }
+
+        // hunks: changed runs plus three lines of context, joined when the gap between them is small
+        const size_t context = 3;
+        vector<pair<size_t, size_t>> hunks;
+        for (size_t r = 0; r < runs.size(); ++r) {
+            if (runs[r].kind == LineDiff::SAME) continue;
+            if (!hunks.empty() && (r == hunks.back().second + 1 ||
+                (r == hunks.back().second + 2 && runs[r - 1].count <= 2 * context))) {
+                hunks.back().second = r;
+            }
+            else {
+                hunks.push_back({ r, r });
+            }
+        }
+
+        vector<size_t> wanted;
+        for (const LineDiff::Run& run : runs) {
+            if (run.kind == LineDiff::REMOVED)
+                for (size_t i = 0; i < run.count; ++i) wanted.push_back(run.oldLine + i);
+        }
+        vector<string> removedText;
+        if (!readFileLines(filename, wanted, removedText)) {
+            status.message = "Cannot read " + filename;
+            return false;
+        }
+        size_t nextRemoved = 0;
+        auto bufferLine = [&](size_t line) -> string {
+            if (!pageIn(line, line)) return "(cannot read back this line)";
+            return lines[line].content();
+        };
+
+        string view;
+        size_t half = sideBySide ? max<size_t>(10, (terminalColumns() - 3) / 2) : 0;
+        if (sideBySide) {
+            view += fitColumns(filename + " (on disk)", half) + "   " + filename + " (buffer)\n";
+        }
+        else {
+            view += "--- " + filename + " (on disk)\n+++ " + filename + " (buffer)\n";
+        }
+        for (const pair<size_t, size_t>& hunk : hunks) {
+            const LineDiff::Run& first = runs[hunk.first];
+            size_t lead = hunk.first > 0 ? min(context, runs[hunk.first - 1].count) : 0;
+            size_t trail = hunk.second + 1 < runs.size() ? min(context, runs[hunk.second + 1].count) : 0;
+            size_t oldStart = first.oldLine - lead, newStart = first.newLine - lead;
+            const LineDiff::Run& last = runs[hunk.second];
+            size_t oldEnd = last.oldLine + (last.kind == LineDiff::ADDED ? 0 : last.count) + trail;
+            size_t newEnd = last.newLine + (last.kind == LineDiff::REMOVED ? 0 : last.count) + trail;
+            auto range = [](size_t start, size_t count) {
+                return to_string(count == 0 ? start : start + 1) + "," + to_string(count);
+            };
+            view += "@@ -" + range(oldStart, oldEnd - oldStart) + " +" + range(newStart, newEnd - newStart) + " @@\n";
+
+            auto same = [&](size_t line) {
+                string text = bufferLine(line);
+                view += sideBySide ? fitColumns(text, half) + "   " + fitColumns(text, half) : " " + text;
+                view += '\n';
+            };
+            for (size_t i = 0; i < lead; ++i) same(newStart + i);
+            for (size_t r = hunk.first; r <= hunk.second; ++r) {
+                const LineDiff::Run& run = runs[r];
+                if (run.kind == LineDiff::SAME) {
+                    for (size_t i = 0; i < run.count; ++i) same(run.newLine + i);
+                }
+                else if (!sideBySide) {
+                    for (size_t i = 0; i < run.count; ++i) {
+                        view += run.kind == LineDiff::REMOVED ? "-" + removedText[nextRemoved++] : "+" + bufferLine(run.newLine + i);
+                        view += '\n';
+                    }
+                }
+                else if (run.kind == LineDiff::REMOVED) {
+                    // a removal followed by an addition is shown as changed lines side by side
+                    size_t paired = r + 1 <= hunk.second && runs[r + 1].kind == LineDiff::ADDED ? runs[r + 1].count : 0;
+                    size_t rows = max(run.count, paired);
+                    for (size_t i = 0; i < rows; ++i) {
+                        string left = i < run.count ? removedText[nextRemoved++] : "";
+                        string right = i < paired ? bufferLine(runs[r + 1].newLine + i) : "";
+                        char marker = i < run.count && i < paired ? '|' : i < run.count ? '<' : '>';
+                        view += fitColumns(left, half) + " " + marker + " " + fitColumns(right, half) + "\n";
+                    }
+                    if (paired) r++;
+                }
+                else {
+                    for (size_t i = 0; i < run.count; ++i) {
+                        view += fitColumns("", half) + " > " + fitColumns(bufferLine(run.newLine + i), half) + "\n";
+                    }
+                }
+            }
+            size_t afterNew = last.newLine + (last.kind == LineDiff::REMOVED ? 0 : last.count);
+            for (size_t i = 0; i < trail; ++i) same(afterNew + i);
+        }
+        showView(filename + ".diff", view);
+        status.message = "+" + to_string(added) + " -" + to_string(removed) + " lines; :bp to return";
+        return true;
     }
 
-    bool isPunctuation(char c) 
-    {
-        if (c == '.' || c == ',' || c == ';' || c == ':' || c == '!' || c == '?' ||
-            c == '"' || c == '\'' || c == '(' || c == ')' || c == '-' || c == '_') {
-            return true;
+    // shows text in a read-only buffer of its own, replacing an earlier view of that name
+    void showView(const string& name, const string& text) {
+        stashActiveBuffer();
+        size_t index = buffers.find(name);
+        if (index == buffers.count()) index = buffers.add(name);
+        buffers.at(index).clear();
+        buffers.setActive(index);
+        lines.clear();
+        for (size_t pos = 0; pos < text.size();) {
+            const void* newline = memchr(text.data() + pos, '\n', text.size() - pos);
+            size_t end = newline ? static_cast<const char*>(newline) - text.data() : text.size();
+            lines.push_back(LinkedList::fromText(text.data() + pos, end - pos));
+            pos = end + 1;
         }
-        return false;
+        if (lines.empty()) lines.emplace_back();
+        pager.reset("", false);
+        baseline.detach(lines);
+        fileManager.setCurrentFile(name, false, true);
+        incompleteLoad = false;
+        linesReloaded();
+        resetBookmarks();
+        currentLine = 0;
+        charCursor = lines[0].begin();
+        buffers.enforceBudget();
     }
 
-public:
-    TextEditor() : currentLine(0), insertMode(true), charCursor(nullptr), copyBuffer("") 
-    {
-        lines.emplace_back();
-        charCursor = lines[0].begin();
-        status = { EditorStatus::INSERT, 0, 0, 1, "" };
+    // streaming load
+    bool isLoading() const {
+        return loader.isLoading();
     }
 
-    // Search commands
-    bool search(const string& pattern) 
-    {
-        int cursorPos = status.cursorColumn;
-        return searchEngine.search(pattern, lines, currentLine, charCursor, cursorPos);
+    // moves lines the loader has parsed since the last call into the buffer
+    void pollLoad() {
+        size_t first = lines.size();
+        vector<uint64_t> hashes;
+        bool more = loader.take(lines, hashes);
+        linesLoaded(first, hashes);
+        if (!more) loadFinished();
+        if (!more && loader.hasFailed()) {
+            incompleteLoad = true;
+            status.message = "Corrupt or truncated compressed data -- " + to_string(lines.size()) + " lines kept";
+        }
+        else if (!more && loader.wasCancelled()) {
+            incompleteLoad = true;
+            status.message = "Load cancelled -- " + to_string(lines.size()) + " lines kept";
+        }
     }
-    bool findNext() 
-    {
-        int cursorPos = status.cursorColumn;
-        return searchEngine.findNext(lines, currentLine, charCursor, cursorPos);
+
+    // the baseline learns how the file ended, or that it was not read in whole
+    void loadFinished() {
+        if (loader.hasFailed() || loader.wasCancelled())
+            baseline.forget();
+        else
+            baseline.setTerminated(!loader.lastLineOpen());
     }
-    bool findPrevious() 
-    {
-        int cursorPos = status.cursorColumn;
-        return searchEngine.findPrevious(lines, currentLine, charCursor, cursorPos);
+
+    void cancelLoad() {
+        loader.cancel();
+        while (isLoading()) pollLoad();
     }
 
-    // Replace commands
-    void replace(const string& old, const string& newStr, bool global = false) {
-        searchEngine.replace(old, newStr, lines[currentLine], global);
+    void finishLoad() {
+        while (isLoading()) pollLoad();
     }
 
-    // Advanced commands
-    void joinLines() {
-        if (currentLine < lines.size() - 1) {
-            LinkedList::Iterator iter = lines[currentLine + 1].begin();
-            while (iter != lines[currentLine + 1].end()) {
-                LinkedList::Iterator it = lines[currentLine].end();
+    // buffers
+    void stashActiveBuffer() {
+        finishLoad();
+        Buffer& buffer = buffers.current();
+        buffer.fileName = fileManager.hasFileName() ? fileManager.getCurrentFileName() : "";
+        buffer.modified = fileManager.hasUnsavedChanges();
+        buffer.readOnly = fileManager.isReadOnly();
+        buffer.cursorLine = currentLine;
+        buffer.cursorOffset = cursorOffset();
+        buffer.baseline.swap(baseline);
+        swapBookmarks(buffer);
+        buffer.park(lines, pager);
+    }
 
-                lines[currentLine].insertChar(it, *iter);
-                ++iter;
-            }
-            lines.erase(lines.begin() + currentLine + 1);
+    bool restoreBuffer(Buffer& buffer) {
+        if (buffer.isParked()) {
+            buffer.unpark(lines, pager);
+        }
+        else if (!buffer.thaw(lines)) {
+            return false;
         }
+        baseline.swap(buffer.baseline);
+        swapBookmarks(buffer);
+        return true;
     }
 
-    void indentLine(bool increase) {
-        char indentChar = '\t';
-        if (increase) {
-            LinkedList::Iterator iter = lines[currentLine].begin();
-            --iter;
-            lines[currentLine].insertChar(iter, indentChar);
+    bool switchToBuffer(size_t index) {
+        if (index == buffers.activeIndex() || index >= buffers.count()) return false;
+        size_t previous = buffers.activeIndex();
+        stashActiveBuffer();
+        Buffer& target = buffers.at(index);
+        if (!restoreBuffer(target)) {
+            restoreBuffer(buffers.at(previous));
+            status.message = "Cannot reload " + target.fileName;
+            return false;
         }
-        else {
-            if (*lines[currentLine].begin() == indentChar) {
-                LinkedList::Iterator iter = lines[currentLine].begin();
+        buffers.setActive(index);
+        fileManager.setCurrentFile(target.fileName, target.modified, target.readOnly);
+        linesReloaded();
+        currentLine = min(target.cursorLine, static_cast<int>(lines.size()) - 1);
+        pageIn(currentLine, currentLine);
+        setCursorOffset(min(target.cursorOffset, lines[currentLine].size()));
+        buffers.enforceBudget();
+        return true;
+    }
 
-                lines[currentLine].deleteChar(iter);
-            }
+    bool openBuffer(const string& filename) {
+        size_t existing = buffers.find(filename);
+        if (existing < buffers.count()) {
+            return existing == buffers.activeIndex() || switchToBuffer(existing);
         }
-    }
+        string error;
+        unique_ptr<ByteSource> source = FileManager::openSource(filename, error);
+        if (!source) {
+            status.message = error;
+            return false;
+        }
+        long long fileBytes = static_cast<long long>(ifstream(filename, ios::binary | ios::ate).tellg());
+        // an untouched scratch buffer is replaced rather than kept around
+        bool replaceScratch = !fileManager.hasFileName() && !fileManager.hasUnsavedChanges() &&
+            lines.size() == 1 && lines[0].isEmpty();
+        size_t previous = buffers.activeIndex();
+        stashActiveBuffer();
+        size_t index = buffers.add(filename);
+        buffers.setActive(index);
+        if (replaceScratch) buffers.remove(previous);
 
-    void deleteLineNumber(size_t lineNum) {
-        lineNum--;
-        if (lineNum < lines.size()) {
-            lines.erase(lines.begin() + lineNum);
-            if (currentLine >= lines.size()) {
-                currentLine = lines.size() - 1;
-            }
-            charCursor = lines[currentLine].begin();
+        // files whose nodes would not fit under the cap are loaded as statistics only and
+        // paged in from the file; compressed ones cannot be read back at an offset, so
+        // their blocks are built in memory and spilled once the cap is reached
+        bool compressed = FileManager::detectCompression(filename) != COMPRESSION_NONE;
+        size_t nodeBytes = static_cast<size_t>(max(0LL, fileBytes)) * LinePager::nodeCost;
+        bool cold = !compressed && nodeBytes > pager.cap();
+        // assume at least 4:1 compression when guessing whether a compressed file will fit
+        pager.reset(cold ? filename : "", cold || (compressed && nodeBytes * 4 > pager.cap()));
+        loader.start(move(source), fileBytes, cold);
+        loader.waitForLines();
+        vector<uint64_t> hashes;
+        bool more = loader.take(lines, hashes);
+        pager.append(lines, 0);
+        baseline.reset();
+        baseline.loaded(lines, 0, hashes);
+        if (!more) loadFinished();
+        if (lines.empty()) {
+            lines.emplace_back();
+            baseline.lineInserted(lines, 0);
         }
+        fileManager.loadFile(filename);
+        incompleteLoad = false;
+        linesReloaded();
+        resetBookmarks();
+        currentLine = 0;
+        charCursor = lines[currentLine].begin();
+        buffers.enforceBudget();
+        return true;
     }
 
-    // file commands
-    bool handleFileCommand(const string& cmd) {
-        
-        if (cmd.rfind("w ", 0) == 0) { 
-            string filename = cmd.substr(2);
-            if (fileManager.saveFile(filename, lines)) {
-                cout << "file : " << filename << " saved";
-                return true;
-            }
-
+    // follow mode
+    bool startFollow() {
+        if (!fileManager.hasFileName()) {
+            status.message = "No file to follow";
+            return false;
         }
-        else if (cmd == "q") {
-            if (fileManager.hasUnsavedChanges()) {
-                cout << "Warning: Unsaved changes -- Use :q! to force quit\n";
-                Sleep(1000);
+        if (fileManager.isCompressed()) {
+            status.message = "Cannot follow a compressed file";
+            return false;
+        }
+        string filename = fileManager.getCurrentFileName();
+        baseline.forget();
+        // an unmodified buffer holds exactly what was read, so continue right after it
+        long long startOffset = LLONG_MAX;
+        lastLineOpen = false;
+        if (!fileManager.hasUnsavedChanges()) {
+            startOffset = static_cast<long long>(totalBytes());
+            ifstream file(filename, ios::binary);
+            char last = 0;
+            bool terminated = file.seekg(startOffset - 1) && file.get(last) && last == '\n';
+            if (!terminated) {
+                startOffset--;
+                lastLineOpen = true;
             }
-            else {
-                exit(0);
+            if (lines.size() == 1 && lines[0].isEmpty()) {
+                startOffset = 0;
+                lastLineOpen = true;
             }
         }
-        else if (cmd == "q!") { 
-            exit(0);
+        if (!follower.start(filename, startOffset)) {
+            status.message = "Cannot follow " + filename;
+            return false;
         }
-        else if (cmd == "wq") { 
-            if (!fileManager.getCurrentFileName().empty() &&
-                fileManager.saveFile(fileManager.getCurrentFileName(), lines)) {
-                exit(0);
-            }
+        exitInsertMode();
+        pinToBottom();
+        status.message = "Following " + filename + " -- press any key to stop";
+        return true;
+    }
+
+    void stopFollow() {
+        follower.stop();
+    }
+
+    bool isFollowing() const {
+        return follower.isFollowing();
+    }
 
+    int followHandle() const {
+        return follower.notifyHandle();
+    }
+
+    // reads whatever was appended to the followed file; returns whether anything changed
+    bool pollFollow() {
+        string chunk;
+        FileFollower::Event event = follower.poll(chunk, 64u * 1024 * 1024);
+        if (event == FileFollower::TRUNCATED || event == FileFollower::ROTATED) {
+            lastLineOpen = false;
         }
-        else if (cmd.rfind("e ", 0) == 0) { 
-            string filename = cmd.substr(2);
-            if (fileManager.loadFile(filename)) {
-                lines.clear();
-                ifstream file(filename);
-                string line;
-                while (std::getline(file, line)) {
-                    LinkedList linkedLine;
-                    LinkedList::Iterator iter = linkedLine.end();
-
-                    for (char ch : line) {
-                        linkedLine.insertChar(iter, ch);
-                    }
-                    lines.push_back(linkedLine);
+        if (!chunk.empty()) {
+            appendFollowedText(chunk.data(), chunk.size());
+            pinToBottom();
+        }
+        if (event == FileFollower::TRUNCATED)
+            status.message = "File truncated -- following from the start";
+        else if (event == FileFollower::ROTATED)
+            status.message = "File rotated -- following the new file";
+        return event != FileFollower::NONE;
+    }
+
+    void appendFollowedText(const char* text, size_t len) {
+        size_t pos = 0;
+        while (pos < len) {
+            const void* newline = memchr(text + pos, '\n', len - pos);
+            size_t end = newline ? static_cast<const char*>(newline) - text : len;
+            if (lastLineOpen) {
+                size_t last = lines.size() - 1;
+                pageIn(last, last);
+                LinkedList::Iterator iter = lines[last].last();
+                for (size_t i = pos; i < end; ++i) {
+                    lines[last].insertChar(iter, text[i]);
                 }
-                currentLine = 0;
-                charCursor = lines[currentLine].begin();
-                return true;
+                lineEdited(last);
             }
-
+            else {
+                lines.push_back(LinkedList::fromText(text + pos, end - pos));
+                lineInserted(lines.size() - 1);
+            }
+            lastLineOpen = newline == nullptr;
+            pos = end + 1;
         }
-        return false;
+    }
+
+    void pinToBottom() {
+        currentLine = static_cast<int>(lines.size()) - 1;
+        charCursor = lines[currentLine].begin();
     }
 
     //insert
     void insertChar(char ch) 
     {
         lines[currentLine].insertChar(charCursor, ch);
+        lineEdited(currentLine);
         updateModifiedStatus();
     }
 
@@ -491,11 +4500,18 @@ public:
                 ++currentLineCursor;
             }
             lines.erase(lines.begin() + currentLine);
+            lineErased(currentLine);
             currentLine--;
+            lineEdited(currentLine);
             charCursor = lines[currentLine].last();
         }
-        else {
-            lines[currentLine].deleteChar(charCursor);
+        else if (charCursor != nullptr) {
+            // remove the whole code point that ends at the cursor
+            size_t sequenceBytes = sequenceEndingAt(charCursor.getNode());
+            for (size_t i = 0; i < sequenceBytes; ++i) {
+                lines[currentLine].deleteChar(charCursor);
+            }
+            lineEdited(currentLine);
         }
         updateModifiedStatus();
     }
@@ -503,6 +4519,7 @@ public:
     void deleteCurrentLine() {
         if (lines.size() > 1) {
             lines.erase(lines.begin() + currentLine);
+            lineErased(currentLine);
             if (currentLine >= lines.size()) {
                 currentLine = lines.size() - 1;
             }
@@ -510,6 +4527,7 @@ public:
         }
         else {
             lines[currentLine] = LinkedList();
+            lineEdited(currentLine);
             charCursor = lines[currentLine].begin();
         }
         updateModifiedStatus();
@@ -523,37 +4541,60 @@ public:
             lines[currentLine].deleteChar(charCursor);
             charCursor = nextChar;
         }
+        lineEdited(currentLine);
         updateModifiedStatus();
     }
 
     // movement
+    // vertical moves keep the cursor's column where the target line is long enough
     void moveUp() {
         if (currentLine > 0) {
+            size_t column = lines[currentLine].columnOfOffset(cursorOffset());
             currentLine--;
-            charCursor = lines[currentLine].begin();
+            setCursorOffset(lines[currentLine].offsetOfColumn(column));
         }
     }
     void moveDown() {
         if (currentLine < lines.size() - 1) {
+            size_t column = lines[currentLine].columnOfOffset(cursorOffset());
             currentLine++;
-            charCursor = lines[currentLine].begin();
+            setCursorOffset(lines[currentLine].offsetOfColumn(column));
         }
     }
+    // length of the well-formed sequence ending at node, judged as utf8SequenceLength does
+    static size_t sequenceEndingAt(Node* node) {
+        char bytes[4];
+        Node* lead = node;
+        size_t count = 1;
+        while (count < 4 && isUtf8Continuation(lead->data) && lead->prev) {
+            lead = lead->prev;
+            count++;
+        }
+        if (count == 1) return 1;
+        Node* walk = lead;
+        for (size_t i = 0; i < count; ++i, walk = walk->next) bytes[i] = walk->data;
+        return utf8SequenceLength(bytes, 0, count) == count ? count : 1;
+    }
+    // length of the well-formed sequence starting at node
+    static size_t sequenceStartingAt(Node* node) {
+        char bytes[4];
+        size_t count = 0;
+        for (Node* walk = node; walk && count < 4; walk = walk->next) bytes[count++] = walk->data;
+        return utf8SequenceLength(bytes, 0, count);
+    }
+
+    // moves step over whole UTF-8 sequences; a stray byte counts as one character
     void moveLeft() {
-        if (charCursor != lines[currentLine].begin()) 
-            --charCursor;
-        if (charCursor == lines[currentLine].begin())
-            charCursor = nullptr;
+        Node* node = charCursor.getNode();
+        if (!node) return;
+        for (size_t i = sequenceEndingAt(node); i > 1; --i) node = node->prev;
+        charCursor = LinkedList::Iterator(node->prev);
     }
     void moveRight() {
-        if (charCursor == nullptr && lines[currentLine].begin() != nullptr) 
-        {
-            charCursor = lines[currentLine].begin();
-        }
-        else if (charCursor != lines[currentLine].end() && charCursor.getNode()->next != nullptr) 
-        {
-            ++charCursor;
-        }
+        Node* node = charCursor == nullptr ? lines[currentLine].begin().getNode() : charCursor.getNode()->next;
+        if (!node) return;
+        for (size_t i = sequenceStartingAt(node); i > 1; --i) node = node->next;
+        charCursor = LinkedList::Iterator(node);
     }
 
     void moveToStartOfLine() {
@@ -569,63 +4610,61 @@ public:
     }
 
 
-    void moveToNextWord() {
-        while (charCursor != lines[currentLine].end() && !isWordCharacter(*charCursor)) {
-            ++charCursor;
-        }
-        while (charCursor != lines[currentLine].end() && isWordCharacter(*charCursor)) {
-            ++charCursor;
-        }
-        while (charCursor != lines[currentLine].end() && !isWordCharacter(*charCursor)) {
-            ++charCursor;
-        }
-        if (charCursor == lines[currentLine].end() && currentLine < lines.size() - 1) {
-            currentLine++;
-            charCursor = lines[currentLine].begin();
+    void moveToNextWord(int count = 1) {
+        size_t pos = cursorOffset();
+        for (int n = 0; n < count; ++n) {
+            const string& text = lines[currentLine].content();
+            pos = scanWordRun(text.data(), pos, text.size(), true);
+            pos = scanWordRun(text.data(), pos, text.size(), false);
+            if (pos == text.size() && currentLine < lines.size() - 1) {
+                currentLine++;
+                pageIn(currentLine, currentLine);
+                const string& next = lines[currentLine].content();
+                pos = scanWordRun(next.data(), 0, next.size(), false);
+            }
         }
+        setCursorOffset(pos);
     }
 
-    void moveToPreviousWord() {
-        while (charCursor != lines[currentLine].begin() && !isWordCharacter(*charCursor)) {
-            --charCursor;
-        }
-        while (charCursor != lines[currentLine].begin() && isWordCharacter(*charCursor)) {
-            --charCursor;
-        }
-        if (charCursor != lines[currentLine].begin() && isWordCharacter(*charCursor)) {
-            while (charCursor != lines[currentLine].begin() && isWordCharacter(*charCursor)) {
-                --charCursor;
+    void moveToPreviousWord(int count = 1) {
+        size_t pos = cursorOffset();
+        for (int n = 0; n < count; ++n) {
+            if (pos == 0 && currentLine > 0) {
+                currentLine--;
+                pageIn(currentLine, currentLine);
+                pos = lines[currentLine].size();
             }
+            const string& text = lines[currentLine].content();
+            pos = scanWordRunBack(text.data(), pos, false);
+            pos = scanWordRunBack(text.data(), pos, true);
         }
-        if (charCursor == lines[currentLine].begin()) {
-            --charCursor;
-        }
+        setCursorOffset(pos);
     }
 
-    void moveToWordEnd() {
-        while (charCursor != lines[currentLine].end() && isWordCharacter(*charCursor)) {
-            ++charCursor;
-        }
-        if (charCursor == lines[currentLine].end()) {
-            if (currentLine < lines.size() - 1) {
+    void moveToWordEnd(int count = 1) {
+        size_t pos = cursorOffset();
+        for (int n = 0; n < count; ++n) {
+            const string& text = lines[currentLine].content();
+            pos = scanWordRun(text.data(), pos, text.size(), false);
+            if (pos == text.size() && currentLine < lines.size() - 1) {
                 currentLine++;
-                charCursor = lines[currentLine].begin();
+                pageIn(currentLine, currentLine);
+                const string& next = lines[currentLine].content();
+                pos = scanWordRun(next.data(), 0, next.size(), false);
             }
+            const string& current = lines[currentLine].content();
+            pos = scanWordRun(current.data(), pos, current.size(), true);
         }
-        else {
-
-            if (charCursor != lines[currentLine].begin()) {
-                --charCursor;
-            }
-        }
-        status.cursorColumn = lines[currentLine].distance(lines[currentLine].begin(), charCursor) + 1;
+        setCursorOffset(pos);
     }
 
     //new line
     void newLine() {
         lines.insert(lines.begin() + currentLine + 1, LinkedList());
+        lineInserted(currentLine + 1);
         currentLine++;
         charCursor = lines[currentLine].begin();
+        updateModifiedStatus();
     }
 
     // modes
@@ -644,37 +4683,277 @@ public:
     // copy paste
     void yankLine() {
         if (!lines[currentLine].getLineContent().empty()) {
-            copyBuffer = lines[currentLine].getLineContent();
+            copyRegister.kind = Register::LINES;
+            copyRegister.text.assign(1, lines[currentLine].getLineContent());
             status.lastCommand = "yy";
         }
     }
 
     void pasteAfter() {
-        if (!copyBuffer.empty()) {
-            lines.insert(lines.begin() + currentLine + 1, LinkedList());
-            LinkedList::Iterator iter = lines[currentLine + 1].begin();
-
-            for (char ch : copyBuffer) {
-                lines[currentLine + 1].insertChar(iter, ch);
-            }
+        if (!copyRegister.text.empty()) {
+            if (copyRegister.kind == Register::LINES)
+                insertLines(currentLine + 1, copyRegister.text);
+            else
+                pasteText(cursorOffset());
             status.lastCommand = "p";
-            status.totalLines++;
+            updateModifiedStatus();
         }
-        updateModifiedStatus();
     }
 
     void pasteBefore() {
-        if (!copyBuffer.empty()) {
-            lines.insert(lines.begin() + currentLine, LinkedList());
-            LinkedList::Iterator iter = lines[currentLine].begin();
-
-            for (char ch : copyBuffer) {
-                lines[currentLine].insertChar(iter, ch);
+        if (!copyRegister.text.empty()) {
+            if (copyRegister.kind == Register::LINES) {
+                insertLines(currentLine, copyRegister.text);
+                currentLine += copyRegister.text.size();
+            }
+            else {
+                size_t column = lines[currentLine].columnOfOffset(cursorOffset());
+                pasteText(lines[currentLine].offsetOfColumn(column > 0 ? column - 1 : 0));
             }
             status.lastCommand = "P";
-            status.totalLines++;
-            currentLine++;
+            updateModifiedStatus();
+        }
+    }
+
+    void insertLines(size_t index, const vector<string>& text) {
+        vector<LinkedList> added;
+        added.reserve(text.size());
+        for (const auto& line : text) {
+            added.push_back(LinkedList::fromText(line.data(), line.size()));
+        }
+        lines.insert(lines.begin() + index, make_move_iterator(added.begin()), make_move_iterator(added.end()));
+        lineInserted(index, text.size());
+    }
+
+    void eraseLines(size_t first, size_t count) {
+        pageIn(first, first + count - 1);
+        for (size_t i = first; i < first + count; ++i) {
+            lines[i].deleteLine();
+        }
+        lines.erase(lines.begin() + first, lines.begin() + first + count);
+        lineErased(first, count);
+        if (lines.empty()) {
+            lines.emplace_back();
+            lineInserted(0);
+        }
+        if (currentLine >= static_cast<int>(lines.size())) currentLine = lines.size() - 1;
+    }
+
+    // pastes a CHARS or BLOCK register at byte offset in the current line
+    void pasteText(size_t offset) {
+        const vector<string>& text = copyRegister.text;
+        if (copyRegister.kind == Register::BLOCK) {
+            pageIn(currentLine, currentLine + text.size());
+            size_t column = lines[currentLine].columnOfOffset(offset);
+            for (size_t k = 0; k < text.size(); ++k) {
+                size_t line = currentLine + k;
+                if (line >= lines.size()) {
+                    lines.emplace_back();
+                    lineInserted(line);
+                }
+                size_t width = lines[line].getStats().codePoints;
+                if (width < column) {
+                    string padding(column - width, ' ');
+                    lines[line].insertText(lines[line].size(), padding.data(), padding.size());
+                }
+                lines[line].insertText(lines[line].offsetOfColumn(column), text[k].data(), text[k].size());
+                lineEdited(line);
+            }
+        }
+        else if (text.size() == 1) {
+            lines[currentLine].insertText(offset, text[0].data(), text[0].size());
+            lineEdited(currentLine);
+        }
+        else {
+            string tail = lines[currentLine].content().substr(offset);
+            lines[currentLine].eraseRange(offset, lines[currentLine].size());
+            lines[currentLine].insertText(offset, text[0].data(), text[0].size());
+            lineEdited(currentLine);
+            vector<string> rest(text.begin() + 1, text.end());
+            rest.back() += tail;
+            insertLines(currentLine + 1, rest);
+        }
+        setCursorOffset(min(offset, lines[currentLine].size()));
+    }
+
+    // visual modes
+    bool isVisualMode() const {
+        return status.currentMode == EditorStatus::VISUAL || status.currentMode == EditorStatus::VISUAL_LINE ||
+            status.currentMode == EditorStatus::VISUAL_BLOCK;
+    }
+
+    // pressing the key of the active visual mode again leaves it
+    void enterVisualMode(EditorStatus::Mode mode) {
+        if (status.currentMode == mode) {
+            exitVisualMode();
+            return;
+        }
+        if (!isVisualMode()) {
+            anchorLine = currentLine;
+            anchorColumn = cursorCharColumn();
+        }
+        status.currentMode = mode;
+    }
+
+    void exitVisualMode() {
+        if (isVisualMode()) status.currentMode = EditorStatus::NORMAL;
+    }
+
+    // column of the character the cursor is on (the one x would delete)
+    size_t cursorCharColumn() const {
+        size_t column = lines[currentLine].columnOfOffset(cursorOffset());
+        return column > 0 ? column - 1 : 0;
+    }
+
+    // Selection geometry captured before an operation starts editing the lines.
+    // Columns are inclusive; for VISUAL they belong to the first and last line, for
+    // VISUAL_BLOCK they are the left and right edges.
+    struct Selection {
+        EditorStatus::Mode mode;
+        size_t first;
+        size_t last;
+        size_t startColumn;
+        size_t endColumn;
+    };
+
+    Selection currentSelection() const {
+        Selection selection;
+        size_t cursorColumn = cursorCharColumn();
+        bool anchorFirst = anchorLine < currentLine || (anchorLine == currentLine && anchorColumn <= cursorColumn);
+        selection.mode = status.currentMode;
+        selection.first = min<size_t>(anchorLine, currentLine);
+        selection.last = max<size_t>(anchorLine, currentLine);
+        if (selection.mode == EditorStatus::VISUAL_BLOCK) {
+            selection.startColumn = min(anchorColumn, cursorColumn);
+            selection.endColumn = max(anchorColumn, cursorColumn);
+        }
+        else {
+            selection.startColumn = anchorFirst ? anchorColumn : cursorColumn;
+            selection.endColumn = anchorFirst ? cursorColumn : anchorColumn;
+        }
+        return selection;
+    }
+
+    // byte range [from, to) of line covered by the selection; false outside it
+    bool selectedBytes(const Selection& selection, size_t line, size_t& from, size_t& to) const {
+        if (line < selection.first || line > selection.last) return false;
+        const LinkedList& text = lines[line];
+        if (selection.mode == EditorStatus::VISUAL_LINE) {
+            from = 0;
+            to = text.size();
+        }
+        else if (selection.mode == EditorStatus::VISUAL_BLOCK) {
+            from = text.offsetOfColumn(selection.startColumn);
+            to = text.offsetOfColumn(selection.endColumn + 1);
+        }
+        else {
+            from = line == selection.first ? text.offsetOfColumn(selection.startColumn) : 0;
+            to = line == selection.last ? text.offsetOfColumn(selection.endColumn + 1) : text.size();
+        }
+        return true;
+    }
+
+    // the anchor may have been paged out while the cursor moved away from it
+    Selection selectionForEdit() {
+        pageIn(min(anchorLine, currentLine), max(anchorLine, currentLine));
+        return currentSelection();
+    }
+
+    void copySelection(const Selection& selection) {
+        copyRegister.kind = selection.mode == EditorStatus::VISUAL_LINE ? Register::LINES :
+            selection.mode == EditorStatus::VISUAL_BLOCK ? Register::BLOCK : Register::CHARS;
+        copyRegister.text.clear();
+        size_t from = 0, to = 0;
+        for (size_t line = selection.first; line <= selection.last; ++line) {
+            selectedBytes(selection, line, from, to);
+            copyRegister.text.push_back(lines[line].content().substr(from, to - from));
+        }
+    }
+
+    void finishSelection(const Selection& selection) {
+        currentLine = min(selection.first, lines.size() - 1);
+        size_t column = selection.mode == EditorStatus::VISUAL_LINE ? 0 : selection.startColumn;
+        setCursorOffset(lines[currentLine].offsetOfColumn(column));
+        exitVisualMode();
+    }
+
+    void yankSelection() {
+        Selection selection = selectionForEdit();
+        copySelection(selection);
+        status.lastCommand = "y";
+        finishSelection(selection);
+    }
+
+    // every selected line is spliced once; nothing is redrawn until the whole edit is done
+    void deleteSelection() {
+        Selection selection = selectionForEdit();
+        copySelection(selection);
+        size_t from = 0, to = 0;
+        if (selection.mode == EditorStatus::VISUAL_LINE) {
+            eraseLines(selection.first, selection.last - selection.first + 1);
+        }
+        else if (selection.mode == EditorStatus::VISUAL_BLOCK || selection.first == selection.last) {
+            for (size_t line = selection.first; line <= selection.last; ++line) {
+                selectedBytes(selection, line, from, to);
+                lines[line].eraseRange(from, to);
+                lineEdited(line);
+            }
+        }
+        else {
+            selectedBytes(selection, selection.last, from, to);
+            string tail = lines[selection.last].content().substr(to);
+            selectedBytes(selection, selection.first, from, to);
+            lines[selection.first].eraseRange(from, to);
+            lines[selection.first].insertText(from, tail.data(), tail.size());
+            lineEdited(selection.first);
+            eraseLines(selection.first + 1, selection.last - selection.first);
+        }
+        finishSelection(selection);
+        updateModifiedStatus();
+    }
+
+    void indentSelection(bool increase) {
+        Selection selection = selectionForEdit();
+        for (size_t line = selection.first; line <= selection.last; ++line) {
+            if (increase)
+                lines[line].insertText(0, "\t", 1);
+            else if (!lines[line].isEmpty() && lines[line].content()[0] == '\t')
+                lines[line].eraseRange(0, 1);
+            lineEdited(line);
         }
+        selection.mode = EditorStatus::VISUAL_LINE;
+        finishSelection(selection);
+        updateModifiedStatus();
+    }
+
+    void replaceSelection(char ch) {
+        Selection selection = selectionForEdit();
+        size_t from = 0, to = 0;
+        for (size_t line = selection.first; line <= selection.last; ++line) {
+            selectedBytes(selection, line, from, to);
+            size_t columns = lines[line].columnOfOffset(to) - lines[line].columnOfOffset(from);
+            string replacement(columns, ch);
+            lines[line].eraseRange(from, to);
+            lines[line].insertText(from, replacement.data(), replacement.size());
+            lineEdited(line);
+        }
+        finishSelection(selection);
+        updateModifiedStatus();
+    }
+
+    // block mode inserts at the left edge of the block, skipping lines that end before it;
+    // the other visual modes insert at the start of every selected line
+    void insertInColumn(const string& text) {
+        Selection selection = selectionForEdit();
+        bool block = selection.mode == EditorStatus::VISUAL_BLOCK;
+        size_t column = block ? selection.startColumn : 0;
+        for (size_t line = selection.first; line <= selection.last; ++line) {
+            if (block && lines[line].getStats().codePoints < column) continue;
+            lines[line].insertText(lines[line].offsetOfColumn(column), text.data(), text.size());
+            lineEdited(line);
+        }
+        if (!block) selection.mode = EditorStatus::VISUAL_LINE;
+        finishSelection(selection);
         updateModifiedStatus();
     }
 
@@ -683,18 +4962,36 @@ public:
 
         status.cursorLine = currentLine + 1;
 
-        int columnPosition = lines[currentLine].distance(lines[currentLine].begin(), charCursor) + 1;
-        if (charCursor == nullptr)
-            columnPosition = 0;
-        status.cursorColumn = columnPosition;
+        size_t line = static_cast<size_t>(currentLine);
+        size_t rows = textRows();
+        if (line < topLine)
+            topLine = line;
+        else if (line >= topLine + rows)
+            topLine = line - rows + 1;
+        // the screen and the lines a single step can reach must be resident
+        pageIn(min(topLine, line > 0 ? line - 1 : 0), max(topLine + rows, line + 1));
+        status.cursorColumn = lines[currentLine].columnOfOffset(cursorOffset());
         status.totalLines = lines.size();
     }
 
+    bool isModified() const {
+        return fileManager.hasUnsavedChanges();
+    }
+
     string getStatusLineText() const {
         string modeText;
         if (insertMode) {
             modeText = "INSERT MODE";
         }
+        else if (status.currentMode == EditorStatus::VISUAL) {
+            modeText = "VISUAL";
+        }
+        else if (status.currentMode == EditorStatus::VISUAL_LINE) {
+            modeText = "VISUAL LINE";
+        }
+        else if (status.currentMode == EditorStatus::VISUAL_BLOCK) {
+            modeText = "VISUAL BLOCK";
+        }
         else {
             modeText = "NORMAL MODE";
         }
@@ -708,10 +5005,29 @@ public:
         string statusLine = "" + modeText + " " + fileName + " " + modifiedFlag + " | Line: " +
             to_string(status.cursorLine) + ", Col: " +
             to_string(status.cursorColumn) + " | Total Lines: " +
-            to_string(status.totalLines);
+            to_string(status.totalLines) + " | Words: " +
+            to_string(lineStats.totals().words) + " | Bytes: " +
+            to_string(totalBytes());
+        if (loader.isLoading())
+            statusLine += " | Loading " + to_string(loader.percentDone()) + "% (Esc to cancel)";
         return statusLine;
     }
 
+    // file size as saveFile would write it, one newline per line
+    size_t totalBytes() const {
+        return lineStats.totals().bytes + lines.size();
+    }
+
+    void wordCount() {
+        const LineStats& totals = lineStats.totals();
+        status.message = to_string(lines.size()) + " lines, " + to_string(totals.words) + " words, " +
+            to_string(totals.codePoints + lines.size()) + " chars, " + to_string(totalBytes()) + " bytes";
+    }
+
+    void clearMessage() {
+        status.message.clear();
+    }
+
     // display
     void display() const {
 #ifdef _WIN32
@@ -721,21 +5037,39 @@ public:
 #endif
         cout << "-----------------\n";
         bool cursorPrinted = false;
-        for (int i = 0; i < lines.size(); ++i) {
-            if (i == currentLine) {
+        vector<unsigned char> colors;
+        Selection selection = {};
+        if (isVisualMode()) selection = currentSelection();
+        size_t bottom = min(lines.size(), topLine + textRows());
+        for (size_t i = topLine; i < bottom; ++i) {
+            const vector<unsigned char>* lineColors = nullptr;
+            if (syntax.enabled()) {
+                syntax.colorize(lines, i, colors);
+                lineColors = &colors;
+            }
+            size_t from = 0, to = 0;
+            if (isVisualMode() && selectedBytes(selection, i, from, to)) {
+                if (!lineColors) colors.assign(lines[i].size(), TC_DEFAULT);
+                for (size_t b = from; b < to; ++b) colors[b] = TC_SELECTED;
+                lineColors = &colors;
+            }
+            if (i == static_cast<size_t>(currentLine)) {
                 if (charCursor == nullptr) {
                     cout << "|";
                 }
-                cursorPrinted = lines[i].printLine(charCursor, cursorPrinted);
+                cursorPrinted = lines[i].printLine(charCursor, cursorPrinted, lineColors);
             }
             else {
-                cursorPrinted = lines[i].printLine(nullptr, cursorPrinted);
+                cursorPrinted = lines[i].printLine(nullptr, cursorPrinted, lineColors);
             }
-            cout << endl;
+            cout << "\n";
         }
 
         cout << "-----------------\n";
         cout << getStatusLineText() << endl;
+        if (!status.message.empty()) {
+            cout << status.message << endl;
+        }
     }
 
 };
@@ -783,19 +5117,64 @@ int getChar() {
 }
 
 
+// waits until a key is pressed (true) or the handle signals / the timeout expires (false)
+bool waitForKeyOrEvent(int handle, int timeoutMs) {
+#ifdef _WIN32
+    (void)handle;
+    for (int waited = 0; waited < timeoutMs; waited += 20) {
+        if (_kbhit()) return true;
+        Sleep(20);
+    }
+    return _kbhit() != 0;
+#else
+    struct termios old_tio, new_tio;
+    tcgetattr(STDIN_FILENO, &old_tio);
+    new_tio = old_tio;
+    new_tio.c_lflag &= (~ICANON & ~ECHO);
+    tcsetattr(STDIN_FILENO, TCSANOW, &new_tio);
+    struct pollfd fds[2] = { { STDIN_FILENO, POLLIN, 0 }, { handle, POLLIN, 0 } };
+    int ready = ::poll(fds, handle >= 0 ? 2 : 1, timeoutMs);
+    tcsetattr(STDIN_FILENO, TCSANOW, &old_tio);
+    return ready > 0 && (fds[0].revents & POLLIN);
+#endif
+}
+
+void enableTerminalColors() {
+#ifdef _WIN32
+    HANDLE output = GetStdHandle(STD_OUTPUT_HANDLE);
+    DWORD mode = 0;
+    if (GetConsoleMode(output, &mode))
+        SetConsoleMode(output, mode | 0x0004); // ENABLE_VIRTUAL_TERMINAL_PROCESSING
+#endif
+}
+
 int main() {
+    enableTerminalColors();
     TextEditor editor;
     int command;
     int nextCommand;
     bool ddFlag = false;
     bool yyFlag = false;
+    int count = 0;
 
     while (true) {
         editor.updateStatusLine();
         editor.display();
+        // keep publishing a streaming load between keystrokes
+        while (editor.isLoading() && !waitForKeyOrEvent(-1, 100)) {
+            editor.pollLoad();
+            editor.updateStatusLine();
+            editor.display();
+        }
         command = getChar();
+        editor.clearMessage();
+        if (command == EOF) {
+            return 0;
+        }
         if (command == 27) {
+            if (editor.isLoading()) editor.cancelLoad();
             editor.exitInsertMode();
+            editor.exitVisualMode();
             continue;
         }
         if (!editor.isInsertMode()) {
@@ -831,6 +5210,25 @@ int main() {
                 else {
                     editor.handleFileCommand(commandBuffer);
                 }
+
+                // follow mode: stay at the bottom of the file until a key is pressed
+                if (editor.isFollowing()) {
+                    bool redraw = true;
+                    while (true) {
+                        if (redraw) {
+                            editor.updateStatusLine();
+                            editor.display();
+                        }
+                        if (waitForKeyOrEvent(editor.followHandle(), 250)) {
+                            getChar();
+                            break;
+                        }
+                        redraw = editor.pollFollow();
+                    }
+                    editor.stopFollow();
+                    editor.clearMessage();
+                    continue;
+                }
             }
 
             //  '/' search commands
@@ -887,10 +5285,62 @@ int main() {
         }
         // normal mode
         else {
+            if (command >= '0' && command <= '9' && (command != '0' || count > 0)) {
+                count = count * 10 + (command - '0');
+                continue;
+            }
+            int counted = count;
+            int repeat = count > 0 ? count : 1;
+            count = 0;
+            if (editor.isVisualMode()) {
+                string insertText;
+                switch (command) {
+                case 'h': case 1004: editor.moveLeft(); break;
+                case 'l': case 1003: editor.moveRight(); break;
+                case 'k': case 1001: editor.moveUp(); break;
+                case 'j': case 1002: editor.moveDown(); break;
+                case 'w': editor.moveToNextWord(repeat); break;
+                case 'b': editor.moveToPreviousWord(repeat); break;
+                case 'e': editor.moveToWordEnd(repeat); break;
+                case 'G': editor.jumpToLine(counted > 0 ? counted - 1 : SIZE_MAX); break;
+                case 'g':
+                    if (getChar() == 'g') editor.jumpToLine(counted > 0 ? counted - 1 : 0);
+                    break;
+                case '0': editor.moveToStartOfLine(); break;
+                case '$': editor.moveToEndOfLine(); break;
+                case 'v': editor.enterVisualMode(EditorStatus::VISUAL); break;
+                case 'V': editor.enterVisualMode(EditorStatus::VISUAL_LINE); break;
+                case 22: editor.enterVisualMode(EditorStatus::VISUAL_BLOCK); break;
+                case 'd': case 'x': editor.deleteSelection(); break;
+                case 'y': editor.yankSelection(); break;
+                case '>': editor.indentSelection(true); break;
+                case '<': editor.indentSelection(false); break;
+                case 'r':
+                    nextCommand = getChar();
+                    if (nextCommand != 27 && nextCommand < 128)
+                        editor.replaceSelection(static_cast<char>(nextCommand));
+                    break;
+                case 'I':
+                    cout << "insert: ";
+                    getline(cin, insertText);
+                    editor.insertInColumn(insertText);
+                    break;
+                }
+                continue;
+            }
             switch (command) {
             case 'i':
                 editor.enterInsertMode();
                 break;
+            case 'v':
+                editor.enterVisualMode(EditorStatus::VISUAL);
+                break;
+            case 'V':
+                editor.enterVisualMode(EditorStatus::VISUAL_LINE);
+                break;
+            case 22: // Ctrl-V
+                editor.enterVisualMode(EditorStatus::VISUAL_BLOCK);
+                break;
             case 'x':
                 editor.deleteChar();
                 break;
@@ -918,17 +5368,17 @@ int main() {
                 yyFlag = false;
                 break;
             case 'w':
-                editor.moveToNextWord();
+                editor.moveToNextWord(repeat);
                 ddFlag = false;
                 yyFlag = false;
                 break;
             case 'b':
-                editor.moveToPreviousWord();
+                editor.moveToPreviousWord(repeat);
                 ddFlag = false;
                 yyFlag = false;
                 break;
             case 'e':
-                editor.moveToWordEnd();
+                editor.moveToWordEnd(repeat);
                 ddFlag = false;
                 yyFlag = false;
                 break;
@@ -980,6 +5430,31 @@ int main() {
             case 'J':
                 editor.joinLines();
                 break;
+            case 'G':
+                editor.jumpToLine(counted > 0 ? counted - 1 : SIZE_MAX);
+                break;
+            case 'g':
+                if (getChar() == 'g') editor.jumpToLine(counted > 0 ? counted - 1 : 0);
+                break;
+            case '%':
+                if (counted > 0) editor.jumpToPercent(counted);
+                break;
+            case 'm':
+                nextCommand = getChar();
+                if (nextCommand >= 'a' && nextCommand <= 'z') editor.setMark(static_cast<char>(nextCommand));
+                break;
+            case '\'':
+            case '`':
+                nextCommand = getChar();
+                if (nextCommand >= 'a' && nextCommand <= 'z')
+                    editor.jumpToMark(static_cast<char>(nextCommand), command == '`');
+                break;
+            case 15: // Ctrl-O
+                editor.jumpOlder();
+                break;
+            case 9: // Ctrl-I
+                editor.jumpNewer();
+                break;
             case '>':
                 nextCommand = getChar();
                 if (nextCommand == '>')
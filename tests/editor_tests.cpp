@@ -0,0 +1,332 @@
+// Checks for the editor's internals. Built from the single source file with its main renamed:
+//
+//     g++ -std=c++17 tests/editor_tests.cpp -o editor_tests -lpthread && ./editor_tests
+#define main editorMain
+#include "../TextEditor.cpp"
+#undef main
+
+#include <map>
+#include <random>
+
+static int failures = 0;
+
+#define CHECK(condition) \
+    do { \
+        if (!(condition)) { \
+            cerr << __FILE__ << ":" << __LINE__ << ": check failed: " #condition "\n"; \
+            failures++; \
+        } \
+    } while (0)
+
+static const char* const scratchFile = "editor_tests.tmp";
+
+// an edit after saving a scratch buffer marks it modified again
+static void testEditAfterSave() {
+    TextEditor editor;
+    for (char ch : string("abc")) editor.insertChar(ch);
+    editor.newLine();
+    for (char ch : string("def")) editor.insertChar(ch);
+    CHECK(editor.handleFileCommand(string("w ") + scratchFile));
+    CHECK(!editor.isModified());
+    editor.insertChar('Z');
+    CHECK(editor.isModified());
+    editor.deleteChar();
+    CHECK(!editor.isModified());
+    remove(scratchFile);
+}
+
+// insertText against fromText of the expected line: same content, words, bytes and code points
+static void testInsertTextModel() {
+    const char alphabet[] = "ab ,\xc3\xa9\t.";
+    mt19937 rng(1);
+    for (int round = 0; round < 200000; ++round) {
+        string line, piece;
+        for (int i = rng() % 8; i > 0; --i) line += alphabet[rng() % (sizeof(alphabet) - 1)];
+        for (int i = rng() % 5; i > 0; --i) piece += alphabet[rng() % (sizeof(alphabet) - 1)];
+        size_t offset = rng() % (line.size() + 1);
+        LinkedList edited = LinkedList::fromText(line.data(), line.size());
+        edited.content();
+        edited.insertText(offset, piece.data(), piece.size());
+        string expected = line.substr(0, offset) + piece + line.substr(offset);
+        LinkedList built = LinkedList::fromText(expected.data(), expected.size());
+        CHECK(edited.content() == expected);
+        CHECK(edited.getStats().words == built.getStats().words);
+        CHECK(edited.getStats().bytes == built.getStats().bytes);
+        CHECK(edited.getStats().codePoints == built.getStats().codePoints);
+        edited.deleteLine();
+        built.deleteLine();
+    }
+}
+
+// deleting a line's only character leaves it empty enough to splice onto, as J does
+static void testSpliceOntoEmptiedLine() {
+    LinkedList line = LinkedList::fromText("a", 1);
+    LinkedList::Iterator cursor = line.last();
+    line.deleteChar(cursor);
+    CHECK(line.isEmpty() && line.last() == line.end());
+    LinkedList next = LinkedList::fromText("bc", 2);
+    line.splice(next);
+    CHECK(line.content() == "bc");
+    CHECK(line.getStats().bytes == 2 && line.getStats().words == 1);
+    line.deleteLine();
+}
+
+// :s rebuilds the line; the cursor keeps its offset instead of pointing at a freed node
+static void testCursorAfterReplace() {
+    TextEditor editor;
+    for (char ch : string("abc")) editor.insertChar(ch);
+    editor.updateStatusLine();
+    string before = editor.getStatusLineText();
+    editor.replace("b", "X");
+    editor.updateStatusLine();
+    CHECK(editor.getStatusLineText().find("Col: 3") != string::npos);
+    CHECK(before.find("Col: 3") != string::npos);
+    editor.replace("aXc", "z");
+    editor.updateStatusLine();
+    CHECK(editor.getStatusLineText().find("Col: 1") != string::npos);
+}
+
+static vector<LinkedList> linesOf(const vector<string>& text) {
+    vector<LinkedList> lines;
+    for (const string& line : text) lines.push_back(LinkedList::fromText(line.data(), line.size()));
+    return lines;
+}
+
+// re-lexing after an insert cannot stop on the inserted lines' placeholder states
+static void testSyntaxAfterInsert() {
+    const Highlighter* cLike = highlighterFor("test.cpp");
+    vector<LinkedList> lines = linesOf({ "/*", "a", "b" });
+    SyntaxCache cache;
+    cache.reset(cLike, lines.size());
+    int inComment = cache.stateBefore(lines, 3);
+    CHECK(inComment != 0);
+    lines.insert(lines.begin() + 1, LinkedList::fromText("*/", 2));
+    cache.lineInserted(1);
+    CHECK(cache.stateBefore(lines, 4) == 0);
+
+    lines = linesOf({ "a", "b" });
+    cache.reset(cLike, lines.size());
+    CHECK(cache.stateBefore(lines, 2) == 0);
+    vector<LinkedList> pasted = linesOf({ "x", "/*" });
+    lines.insert(lines.begin() + 1, make_move_iterator(pasted.begin()), make_move_iterator(pasted.end()));
+    cache.lineInserted(1, 2);
+    CHECK(cache.stateBefore(lines, 4) == inComment);
+}
+
+// the cache after random edits agrees with lexing the text from scratch
+static void testSyntaxModel() {
+    const Highlighter* cLike = highlighterFor("test.cpp");
+    const vector<string> pieces = { "/*", "*/", "a", "\"", "x /* y */", "// c", "" };
+    mt19937 rng(11);
+    for (int round = 0; round < 3000; ++round) {
+        vector<string> text;
+        for (size_t i = 1 + rng() % 8; i > 0; --i) text.push_back(pieces[rng() % pieces.size()]);
+        vector<LinkedList> lines = linesOf(text);
+        SyntaxCache cache;
+        cache.reset(cLike, lines.size());
+        for (int step = 0; step < 20; ++step) {
+            int op = rng() % 3;
+            size_t index = rng() % (lines.size() + (op == 1));
+            if (op == 0) {
+                const string& line = pieces[rng() % pieces.size()];
+                lines[index] = LinkedList::fromText(line.data(), line.size());
+                cache.lineEdited(index);
+            }
+            else if (op == 1) {
+                size_t count = 1 + rng() % 3;
+                for (size_t k = 0; k < count; ++k) {
+                    const string& line = pieces[rng() % pieces.size()];
+                    lines.insert(lines.begin() + index, LinkedList::fromText(line.data(), line.size()));
+                }
+                cache.lineInserted(index, count);
+            }
+            else if (lines.size() > 1) {
+                lines.erase(lines.begin() + index);
+                cache.lineErased(index);
+            }
+            size_t probe = rng() % (lines.size() + 1);
+            SyntaxCache fresh;
+            fresh.reset(cLike, lines.size());
+            CHECK(cache.stateBefore(lines, probe) == fresh.stateBefore(lines, probe));
+        }
+    }
+}
+
+// a cold block is not paged back in once its text changed on disk, even at the same length
+static void testPageInAfterDiskChange() {
+    vector<string> text;
+    string file;
+    while (file.size() < 3 * LinePager::blockBytes) {
+        text.push_back("line " + to_string(text.size()));
+        file += text.back() + "\n";
+    }
+    ofstream(scratchFile, ios::binary) << file;
+    vector<LinkedList> lines;
+    vector<uint64_t> hashes;
+    for (const string& line : text) {
+        lines.push_back(LinkedList::pagedOut(line.data(), line.size()));
+        hashes.push_back(LineDiff::hashLine(line.data(), line.size()));
+    }
+    LinePager pager;
+    pager.verifyAgainst(&hashes);
+    pager.reset(scratchFile, true);
+    pager.append(lines, 0);
+    CHECK(pager.pageIn(lines, 0, 0, 0) && lines[0].content() == text[0]);
+    size_t last = lines.size() - 1;
+    file[file.size() - 2] = file[file.size() - 2] == '0' ? '1' : '0';
+    ofstream(scratchFile, ios::binary) << file;
+    CHECK(!pager.pageIn(lines, last, last, 0));
+    CHECK(lines[last].isPagedOut());
+    remove(scratchFile);
+}
+
+static string fileText(const string& filename) {
+    ifstream file(filename, ios::binary);
+    return string(istreambuf_iterator<char>(file), istreambuf_iterator<char>());
+}
+
+// a same-length change made on disk since the load rules out patching the file in place:
+// the save writes the buffer whole instead of mixing it with the other version
+static void testSaveAfterDiskChange() {
+    ofstream(scratchFile, ios::binary) << "aaa\nbbb\nccc\n";
+    TextEditor editor;
+    CHECK(editor.openBuffer(scratchFile));
+    editor.finishLoad();
+    editor.jumpToLine(1);
+    editor.moveToEndOfLine();
+    editor.deleteChar();
+    editor.insertChar('X');
+    ofstream(scratchFile, ios::binary) << "aaa\nbbb\nzzz\n";
+    CHECK(editor.handleFileCommand(string("w ") + scratchFile));
+    CHECK(fileText(scratchFile) == "aaa\nbbX\nccc\n");
+    remove(scratchFile);
+}
+
+// LineAnchors against a list of which anchor, if any, sits on each line: every handle
+// reports its line until that line is erased, and runs never end up side by side
+static void testLineAnchorsModel() {
+    mt19937 rng(5);
+    for (int round = 0; round < 200; ++round) {
+        size_t count = 1 + rng() % 50;
+        LineAnchors anchors;
+        anchors.reset(count);
+        vector<long> model(count, -1); // anchor id on each line, -1 for none
+        map<size_t, long> idOf;
+        vector<size_t> handles;
+        long nextId = 0;
+        for (int step = 0; step < 2000; ++step) {
+            int op = rng() % 4;
+            if (op == 0) {
+                size_t index = rng() % (model.size() + 1), n = 1 + rng() % 3;
+                anchors.insert(index, n);
+                model.insert(model.begin() + index, n, -1);
+            }
+            else if (op == 1 && model.size() > 1) {
+                size_t index = rng() % model.size();
+                size_t n = min<size_t>(1 + rng() % 3, model.size() - index);
+                if (n == model.size()) continue;
+                anchors.erase(index, n);
+                model.erase(model.begin() + index, model.begin() + index + n);
+            }
+            else if (op == 2) {
+                size_t line = rng() % model.size();
+                if (model[line] < 0) model[line] = nextId++;
+                size_t handle = anchors.add(line);
+                idOf[handle] = model[line];
+                handles.push_back(handle);
+            }
+            else if (op == 3 && !handles.empty()) {
+                size_t pick = rng() % handles.size();
+                size_t handle = handles[pick];
+                handles.erase(handles.begin() + pick);
+                long id = idOf[handle];
+                idOf.erase(handle);
+                anchors.release(handle);
+                bool held = false;
+                for (const auto& entry : idOf) held = held || entry.second == id;
+                if (!held) replace(model.begin(), model.end(), id, -1L);
+            }
+            for (size_t handle : handles) {
+                auto at = find(model.begin(), model.end(), idOf[handle]);
+                size_t line;
+                bool found = anchors.lineOf(handle, line);
+                CHECK(found == (at != model.end()));
+                if (found && at != model.end()) CHECK(line == static_cast<size_t>(at - model.begin()));
+            }
+            size_t anchored = model.size() - static_cast<size_t>(count_if(model.begin(), model.end(), [](long id) { return id < 0; }));
+            CHECK(anchors.pieces() <= 2 * anchored + 1);
+        }
+    }
+}
+
+// DiskBaseline against a direct comparison of the buffer with the file, through edits,
+// inserts and erases made while and after the file loads
+static void testBaselineModel() {
+    mt19937 rng(7);
+    for (int round = 0; round < 20000; ++round) {
+        size_t count = 1 + rng() % 20;
+        vector<string> disk;
+        for (size_t i = 0; i < count; ++i) disk.push_back(string(1, 'a' + rng() % 3));
+        vector<LinkedList> lines;
+        DiskBaseline baseline;
+        baseline.reset();
+        auto edit = [&]() {
+            string text(1, 'a' + rng() % 3);
+            int op = rng() % 3;
+            if (op == 0 && !lines.empty()) {
+                size_t i = rng() % lines.size();
+                lines[i] = LinkedList::fromText(text.data(), text.size());
+                baseline.lineEdited(lines, i);
+            }
+            else if (op == 1) {
+                size_t i = rng() % (lines.size() + 1), n = 1 + rng() % 2;
+                for (size_t k = 0; k < n; ++k) lines.insert(lines.begin() + i, LinkedList::fromText(text.data(), text.size()));
+                baseline.lineInserted(lines, i, n);
+            }
+            else if (!lines.empty()) {
+                size_t i = rng() % lines.size(), n = min<size_t>(1 + rng() % 2, lines.size() - i);
+                lines.erase(lines.begin() + i, lines.begin() + i + n);
+                baseline.lineErased(i, n);
+            }
+        };
+        size_t loaded = 0;
+        for (size_t end : { static_cast<size_t>(rng() % (count + 1)), count }) {
+            size_t first = lines.size();
+            vector<uint64_t> hashes;
+            for (; loaded < end; ++loaded) {
+                lines.push_back(LinkedList::fromText(disk[loaded].data(), disk[loaded].size()));
+                hashes.push_back(LineDiff::hashLine(disk[loaded].data(), disk[loaded].size()));
+            }
+            baseline.loaded(lines, first, hashes);
+            if (end < count) {
+                for (int k = rng() % 3; k > 0; --k) edit();
+            }
+        }
+        for (int step = 0; step < 40; ++step) {
+            edit();
+            if (rng() % 3) continue;
+            bool same = lines.size() == disk.size();
+            for (size_t i = 0; same && i < lines.size(); ++i) same = lines[i].content() == disk[i];
+            CHECK(baseline.matchesDisk() == same);
+        }
+    }
+}
+
+int main() {
+    testEditAfterSave();
+    testInsertTextModel();
+    testSpliceOntoEmptiedLine();
+    testCursorAfterReplace();
+    testSyntaxAfterInsert();
+    testSyntaxModel();
+    testPageInAfterDiskChange();
+    testSaveAfterDiskChange();
+    testLineAnchorsModel();
+    testBaselineModel();
+    if (failures) {
+        cerr << failures << " check(s) failed\n";
+        return 1;
+    }
+    cout << "all checks passed\n";
+    return 0;
+}